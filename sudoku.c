@@ -1,8 +1,21 @@
 /*----------------------------------------------------------------------------*/
 /* sudoku.c (c) 2021 Bernard van der Helm, The Hague, The Netherlands         */
 /*----------------------------------------------------------------------------*/
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "sudoku.h"
 
 #ifdef __TRACE__
 #define Trace(...) printf(__VA_ARGS__)
@@ -10,71 +23,842 @@
 #define Trace(...)
 #endif
 
-#define AllPremiseBitsOn 0x1ff
+/* premise counts, kept as counters or derived from the bits with popcount */
+#ifdef __POPCOUNT__
+#define CellPremises(s, xb, yb, xc, yc) __builtin_popcount((s) -> cell_premise[xb][yb][xc][yc])
+#define BlockPremises(s, xb, yb, p) __builtin_popcount((s) -> block_places[xb][yb][p])
+#define LinePremises(s, l, xy, p) __builtin_popcount((s) -> line_places[l][xy][p])
+#else
+#define CellPremises(s, xb, yb, xc, yc) ((s) -> cell_premises[xb][yb][xc][yc])
+#define BlockPremises(s, xb, yb, p) ((s) -> block_premises[xb][yb][p])
+#define LinePremises(s, l, xy, p) ((s) -> line_premises[l][xy][p])
+#endif
+
+/* the board, SudokuBox from sudoku.h, Digits numbers in Cells cells */
+#define Box SudokuBox
+#define Digits SudokuDigits
+#define Cells SudokuCells
+#define Premises (Cells * Digits)
+#if Box < 2 || Box > 5
+#error SudokuBox must be 2, 3, 4 or 5
+#endif
+
+#define AllPremiseBitsOn ((Mask)((1UL << Digits) - 1))
+#define DlxColumns (4 * Cells)
+#define DlxNodes (1 + DlxColumns + Premises * 4)
+#define EngineDeduce 0
+#define EngineDlx 1
+#define FarmChunk 16
+#define FarmDeal 16
+#define FishSize 4
+#define GroupSize 4
+#define LatencyBuckets (32 + 36 * 16)
+#define LineSize (Cells + 47)
+#define QueueSize (Cells + Units * Digits)
+#define SubsetUnions 224
+#define TrailSize Premises
+#define UndoCopy 0
+#define UndoTrail 1
+
+/* deduce techniques, in order of deduce() */
+#define TechniqueSingles 0
+#define TechniqueBlockSolved 1
+#define TechniqueBlockGroups 2
+#define TechniqueBlockExclusives 3
+#define TechniqueBlockExclusiveGroups 4
+#define TechniqueXLineGroups 5
+#define TechniqueYLineGroups 6
+#define TechniqueXLineBlockGroups 7
+#define TechniqueYLineBlockGroups 8
+#define TechniqueXLineExclusiveGroups 9
+#define TechniqueYLineExclusiveGroups 10
+#define TechniqueXWingX 11
+#define TechniqueXWingY 12
+#define TechniqueSwordfishX 13
+#define TechniqueSwordfishY 14
+#define TechniqueJellyfishX 15
+#define TechniqueJellyfishY 16
+#define Techniques 17
+
+/* clear_premise() reasons */
+#define ReasonFill 0
+#define ReasonSearch 1
+#define ReasonDlx 2
+#define ReasonBlockSolved 3
+#define ReasonBlockGroup 4
+#define ReasonBlockExclusive 5
+#define ReasonBlockExclusiveGroup 6
+#define ReasonXLineGroup 7
+#define ReasonYLineGroup 8
+#define ReasonXLineBlockGroup 9
+#define ReasonYLineBlockGroup 10
+#define ReasonXLineExclusiveGroup 11
+#define ReasonYLineExclusiveGroup 12
+#define ReasonFishX 13
+#define ReasonFishY 14
+#define ReasonNakedSingle 15
+#define ReasonHiddenSingle 16
+#define Reasons 17
+#define RingEvents (1 << 18)
+
+/* step log states */
+#define StepNone 0
+#define StepRound 1
+#define StepCells 2
+#define StepEliminations 3
+
+/* profile formats */
+#define ProfileNone 0
+#define ProfileTable 1
+#define ProfileJson 2
+
+/* units: blocks 0..8, x lines 9..17 and y lines 18..26 on a 9x9 board */
+#define UnitBlock(xb, yb) ((xb) * Box + (yb))
+#define UnitXLine(y) (Digits + (y))
+#define UnitYLine(x) (2 * Digits + (x))
+#define Units (3 * Digits)
+
+/* cell i of a unit as x and y, block cells in xc * Box + yc order */
+#define UnitX(u, i) ((u) < Digits ? (u) / Box * Box + (i) / Box : (u) < 2 * Digits ? (i) : (u) - 2 * Digits)
+#define UnitY(u, i) ((u) < Digits ? (u) % Box * Box + (i) % Box : (u) < 2 * Digits ? (u) - Digits : (i))
+
+/* cells as numbers xb * 27 + yb * 9 + xc * 3 + yc on a 9x9 board and their x and y */
+#define CellNumber(xb, yb, xc, yc) ((xb) * Box * Digits + (yb) * Digits + (xc) * Box + (yc))
+#define CellX(c) ((c) / (Box * Digits) * Box + (c) / Box % Box)
+#define CellY(c) ((c) / Digits % Box * Box + (c) % Box)
+#define CellAt(x, y) {(x) / Box, (y) / Box, (x) % Box, (y) % Box}
+
+/* puzzle symbols, '1'..'9' and then 'A'.. for the numbers above 9, -1 for others */
+#define Symbol(p) ((p) < 9 ? '1' + (p) : 'A' + (p) - 9)
+#define SymbolNumber(c) ((c) >= '1' && (c) <= '9' ? (c) - '1' : (c) >= 'A' && (c) <= 'Z' ? (c) - 'A' + 9 : -1)
+
+/* block places of x line yc and y line xc, 0x49 << yc and 0x7 << xc * 3 on a 9x9 board */
+#define BlockXLine(yc) (AllPremiseBitsOn / ((1 << Box) - 1) << (yc))
+#define BlockYLine(xc) (((1 << Box) - 1) << (xc) * Box)
+
+/* peer k of cell c: the BlockPeers in its block first, then its x line and its y line outside the block */
+#define BlockPeers (Digits - 1)
+#define LinePeers (Digits - Box)
+#define Peers (BlockPeers + 2 * LinePeers)
+#define PeerX(c, k) ((k) < BlockPeers ? (c) / (Box * Digits) * Box + ((k) + ((k) >= (c) % Digits)) / Box :\
+    (k) < BlockPeers + LinePeers ? (k) - BlockPeers + ((k) - BlockPeers >= (c) / (Box * Digits) * Box) * Box : CellX(c))
+#define PeerY(c, k) ((k) < BlockPeers ? (c) / Digits % Box * Box + ((k) + ((k) >= (c) % Digits)) % Box :\
+    (k) < BlockPeers + LinePeers ? CellY(c) : (k) - BlockPeers - LinePeers + ((k) - BlockPeers - LinePeers >= (c) / Digits % Box * Box) * Box)
+#define Peer(c, k) CellAt(PeerX(c, k), PeerY(c, k))
+#define House(u, i) CellAt(UnitX(u, i), UnitY(u, i))
+#define HouseRow(a, u) {EachDigit(House, u)}
+#define PeerRow(a, c) {EachPeer(Peer, c)}
+
+/* lists m(a, o) up to m(a, o + n - 1) for the tables, Rep for the rows and Seq within a row */
+#define Seq1(m, a, o) m(a, o)
+#define Seq2(m, a, o) Seq1(m, a, o), Seq1(m, a, (o) + 1)
+#define Seq4(m, a, o) Seq2(m, a, o), Seq2(m, a, (o) + 2)
+#define Seq8(m, a, o) Seq4(m, a, o), Seq4(m, a, (o) + 4)
+#define Seq16(m, a, o) Seq8(m, a, o), Seq8(m, a, (o) + 8)
+#define Seq32(m, a, o) Seq16(m, a, o), Seq16(m, a, (o) + 16)
+#define Seq64(m, a, o) Seq32(m, a, o), Seq32(m, a, (o) + 32)
+#define Rep1(m, o) m(0, o)
+#define Rep2(m, o) Rep1(m, o), Rep1(m, (o) + 1)
+#define Rep4(m, o) Rep2(m, o), Rep2(m, (o) + 2)
+#define Rep8(m, o) Rep4(m, o), Rep4(m, (o) + 4)
+#define Rep16(m, o) Rep8(m, o), Rep8(m, (o) + 8)
+#define Rep32(m, o) Rep16(m, o), Rep16(m, (o) + 16)
+#define Rep64(m, o) Rep32(m, o), Rep32(m, (o) + 32)
+#define Rep128(m, o) Rep64(m, o), Rep64(m, (o) + 64)
+#define Rep256(m, o) Rep128(m, o), Rep128(m, (o) + 128)
+#define Rep512(m, o) Rep256(m, o), Rep256(m, (o) + 256)
+
+/* Digits, Peers, Units and Cells as sums of powers of 2 */
+#if Box == 2
+#define EachDigit(m, a) Seq4(m, a, 0)
+#define EachPeer(m, a) Seq4(m, a, 0), Seq2(m, a, 4), Seq1(m, a, 6)
+#define EachUnit(m) Rep8(m, 0), Rep4(m, 8)
+#define EachCell(m) Rep16(m, 0)
+#elif Box == 3
+#define EachDigit(m, a) Seq8(m, a, 0), Seq1(m, a, 8)
+#define EachPeer(m, a) Seq16(m, a, 0), Seq4(m, a, 16)
+#define EachUnit(m) Rep16(m, 0), Rep8(m, 16), Rep2(m, 24), Rep1(m, 26)
+#define EachCell(m) Rep64(m, 0), Rep16(m, 64), Rep1(m, 80)
+#elif Box == 4
+#define EachDigit(m, a) Seq16(m, a, 0)
+#define EachPeer(m, a) Seq32(m, a, 0), Seq4(m, a, 32), Seq2(m, a, 36), Seq1(m, a, 38)
+#define EachUnit(m) Rep32(m, 0), Rep16(m, 32)
+#define EachCell(m) Rep256(m, 0)
+#else
+#define EachDigit(m, a) Seq16(m, a, 0), Seq8(m, a, 16), Seq1(m, a, 24)
+#define EachPeer(m, a) Seq64(m, a, 0)
+#define EachUnit(m) Rep64(m, 0), Rep8(m, 64), Rep2(m, 72), Rep1(m, 74)
+#define EachCell(m) Rep512(m, 0), Rep64(m, 512), Rep32(m, 576), Rep16(m, 608), Rep1(m, 624)
+#endif
+
 #define X 0
 #define Y 1
 
+/* premises in bit positions, from sudoku.h */
+typedef SudokuMask Mask;
+
+/*----------------------------------------------------------------------------*/
+/* xb, yb, xc, yc: the position of a cell in the sudoku arrays                */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    unsigned char xb;
+    unsigned char yb;
+    unsigned char xc;
+    unsigned char yc;
+}
+Cell;
+
+/*----------------------------------------------------------------------------*/
+/* cleared       : cleared count after the event, 1 starts a puzzle           */
+/* cell          : cell number, CellNumber(xb, yb, xc, yc)                    */
+/* reason        : reason of clear_premise()                                  */
+/* premise       : premise cleared                                            */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    unsigned short cleared;
+    unsigned short cell;
+    unsigned char reason;
+    unsigned char premise;
+    unsigned char unused[2];
+}
+Event;
+
+/*----------------------------------------------------------------------------*/
+/* events        : the last RingEvents events of a thread                     */
+/* head          : number of events recorded                                  */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    Event *events;
+    unsigned long head;
+}
+Ring;
+
+/*----------------------------------------------------------------------------*/
+/* clears        : cleared premises of the search path, cell * Digits + p     */
+/* tail          : number of clears recorded                                  */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    unsigned short clears[TrailSize];
+    int tail;
+}
+Trail;
+
+/*----------------------------------------------------------------------------*/
+/* text          : json line of the puzzle being solved                       */
+/* size          : allocated size of text                                     */
+/* length        : used length of text                                        */
+/* technique     : technique of the open round                                */
+/* rounds        : rounds written for the puzzle                              */
+/* steps         : steps written for the open round                           */
+/* items         : items written for the open list                            */
+/* state         : StepNone, StepRound, StepCells or StepEliminations         */
+/* mask          : premises of the pattern found                              */
+/* units         : units of the pattern found, written on its first clear     */
+/* places        : places of the pattern within its units                     */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    char *text;
+    size_t size;
+    size_t length;
+    int technique;
+    int rounds;
+    int steps;
+    int items;
+    int state;
+    int mask;
+    int units[FishSize];
+    int places[FishSize];
+}
+Steps;
+
+/*----------------------------------------------------------------------------*/
+/* techniques    : number of techniques in order                              */
+/* order         : the techniques deduce() runs, in this order                */
+/* restart       : restart at the first technique after progress, or go on    */
+/*                 with the next one                                          */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    int techniques;
+    int order[Techniques];
+    int restart;
+}
+Pipeline;
+
+/*----------------------------------------------------------------------------*/
+/* per technique:                                                             */
+/* runs          : number of times run by deduce()                            */
+/* visits        : number of cells visited                                    */
+/* fired         : number of runs making progress                             */
+/* cleared       : number of premises cleared                                 */
+/* nanoseconds   : time spent                                                 */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    long runs[Techniques];
+    long visits[Techniques];
+    long fired[Techniques];
+    long cleared[Techniques];
+    long nanoseconds[Techniques];
+}
+Profile;
 
 /*----------------------------------------------------------------------------*/
+/* the mutable state first, search() snapshots up to the queue:               */
 /* cleared       : number of premises cleared so far                          */
-/* premise_bit   : conversion from bit position to number, 0->1...8->9        */
+/* contradiction : cleared count at the clear leaving a cell without premise  */
+/*                 or a premise without place in a unit, or when search() or  */
+/*                 dlx() found no solution, 0 when none                       */
+/* queue_head    : next single to propagate                                   */
+/* queue_tail    : number of singles queued                                   */
+/* rounds        : number of deduce() calls that made progress, the singles   */
+/*                 one per wave                                               */
+/* waves         : waves of singles the last deduce_singles() took, a wave    */
+/*                 the singles queued before it started                       */
+/* hardest       : hardest technique that made progress, -1 when none         */
+/* score         : sum of the technique weights of the rounds                 */
+/* changed       : per unit the cleared count of its last change              */
+/* seen          : per technique and unit the cleared count it last ran at,   */
+/*                 a technique only reruns on units changed since             */
+/* the premises, the trail can undo their clears:                             */
 /* cell_premise  : premises in bit positions, 0x01->1, 0x10->2, ..., 0x100->9 */
-/* cell_premises : number of premises in cell                                 */
-/* block_premises: number of premises in block                                */
-/* line_premises : number of premises in line x and y                         */
+/* cell_premises : number of premises in cell, not with __POPCOUNT__         */
+/* block_premises: number of premises in block, not with __POPCOUNT__         */
+/* line_premises : number of premises in line x and y, not with __POPCOUNT__  */
+/* block_places  : per premise the cells in block, bit xc * Box + yc          */
+/* line_places   : per premise the cells in line x (bit x) and y (bit y)      */
+/* the rest, the queue only grows past queue_tail within a branch:            */
+/* queue         : singles to propagate, a cell number for a cell down to one */
+/*                 premise, Cells + unit * Digits + premise for a premise     */
+/*                 down to one place in a unit, each happens once so it never */
+/*                 wraps                                                      */
+/* premise_bit   : conversion from bit position to number, 0->1...8->9        */
+/* eliminations  : number of premises cleared, on dead branches too           */
+/* visits        : number of cells visited by the deductions and restores,    */
+/*                 on dead branches too                                       */
+/* pipeline      : techniques deduce() runs                                   */
+/* profile       : technique counters to update, NULL when not profiling      */
+/* ring          : ring buffer to record cleared premises, NULL when not      */
+/* steps         : step log to write the deduce() rounds to, NULL when not    */
+/* trail         : undo trail to record cleared premises, NULL when search()  */
+/*                 restores copies of the board                               */
 /*----------------------------------------------------------------------------*/
 
 typedef struct
 {
     int cleared;
-    int premise_bit[9];
-    
-    int cell_premise[3][3][3][3];
+    int contradiction;
+    int queue_head;
+    int queue_tail;
+    int rounds;
+    int waves;
+    int hardest;
+    int score;
+
+    short changed[Units];
+    short seen[Techniques][Units];
+
+    Mask cell_premise[Box][Box][Box][Box];
+
+#ifndef __POPCOUNT__
+    unsigned char cell_premises[Box][Box][Box][Box];
+    unsigned char block_premises[Box][Box][Digits];
+    unsigned char line_premises[2][Digits][Digits];
+#endif
+
+    Mask block_places[Box][Box][Digits];
+    Mask line_places[2][Digits][Digits];
 
-    int cell_premises[3][3][3][3];
-    int block_premises[3][3][9];
-    int line_premises[2][9][9];
+    unsigned short queue[QueueSize];
+    Mask premise_bit[Digits];
+    long eliminations;
+    long visits;
+
+    const Pipeline *pipeline;
+    Profile *profile;
+    Ring *ring;
+    Steps *steps;
+    Trail *trail;
 }
 Sudoku;
 
+/* the mutable state of a sudoku, about 2 KB, and the part the trail does not undo */
+#define SnapshotSize offsetof(Sudoku, queue)
+#define UntrailedSize offsetof(Sudoku, cell_premise)
+
+/*----------------------------------------------------------------------------*/
+/* boards        : per search depth the board to restore for the next premise */
+/*                 or with the trail only the part before the premises        */
+/* first         : board of the first solution found                          */
+/* depth         : number of boards in use                                    */
+/* solutions     : number of solutions found                                  */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    unsigned char boards[Cells][SnapshotSize];
+    unsigned char first[SnapshotSize];
+    int depth;
+    int solutions;
+}
+Arena;
+
+/*----------------------------------------------------------------------------*/
+/* exact cover matrix, node 0 is the root, nodes 1..DlxColumns the column     */
+/* headers, Cells each for cell filled, x line number, y line number and      */
+/* block number, 0..323 on a 9x9 board. Every premise is a row of 4 nodes,    */
+/* row = cell * Digits + premise with cell = y * Digits + x                   */
+/* left, right, up, down: circular links                                      */
+/* column        : column header of node                                      */
+/* row           : row of node                                                */
+/* size          : number of nodes in column                                  */
+/* solution      : rows chosen so far                                         */
+/* first         : rows of the first exact cover found                        */
+/* found         : number of exact covers found                               */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    int left[DlxNodes];
+    int right[DlxNodes];
+    int up[DlxNodes];
+    int down[DlxNodes];
+    int column[DlxNodes];
+    int row[DlxNodes];
+    int size[DlxColumns + 1];
+    int solution[Cells];
+    int first[Cells];
+    int found;
+    int nodes;
+}
+Dlx;
+
+/*----------------------------------------------------------------------------*/
+/* bench         : corpus name of the benchmark line, NULL when not           */
+/* count         : count solutions up to count, 0 solve only                  */
+/* engine        : EngineDeduce or EngineDlx                                  */
+/* generate      : number of puzzles to generate, 0 to read them              */
+/* grade         : grade the puzzles instead of solving them                  */
+/* jobs          : number of worker threads                                   */
+/* pipeline      : techniques deduce() runs                                   */
+/* profile       : ProfileNone, ProfileTable or ProfileJson                   */
+/* ring          : file to write the ring buffers to, NULL when not recording */
+/* search        : search when deduce() gets stuck                            */
+/* seed          : seed of the generator, the same seed the same puzzles      */
+/* steps         : file to write the step log to, NULL when not logging       */
+/* easiest       : generate puzzles needing at least this technique, -1 any   */
+/* hardest       : and at most this one, Techniques to take puzzles deduce()  */
+/*                 cannot solve too                                           */
+/* timing        : report the throughput on stderr                            */
+/* undo          : UndoCopy or UndoTrail, how search() restores the board     */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    char *bench;
+    int count;
+    int easiest;
+    int engine;
+    long generate;
+    int grade;
+    int hardest;
+    int jobs;
+    Pipeline pipeline;
+    int profile;
+    FILE *ring;
+    int search;
+    unsigned long seed;
+    FILE *steps;
+    int timing;
+    int undo;
+}
+Options;
+
+/*----------------------------------------------------------------------------*/
+/* puzzles       : number of puzzles in the batch                             */
+/* solved        : number of puzzles solved completely                        */
+/* contradicted  : number of puzzles contradicted, no solution by deduction   */
+/* cleared       : number of premises cleared over all puzzles and branches   */
+/* visits        : number of cells visited over all puzzles and branches      */
+/* profile       : technique counters over all puzzles                        */
+/* ring          : cleared premises of the last puzzles                       */
+/* steps         : step log of the puzzle being solved                        */
+/* latency       : per bucket the puzzles solved within its time, with -b     */
+/* arena         : board snapshots of the search                              */
+/* trail         : cleared premises of the search path, with -u trail         */
+/* dlx           : exact cover matrix, with -e dlx                            */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    long puzzles;
+    long solved;
+    long contradicted;
+    long cleared;
+    long visits;
+    Profile profile;
+    Ring ring;
+    Steps steps;
+    long latency[LatencyBuckets];
+    Arena arena;
+    Trail trail;
+    Dlx dlx;
+}
+Totals;
+
+/*----------------------------------------------------------------------------*/
+/* sudoku        : puzzle being solved                                        */
+/* pipeline      : techniques deduce() runs                                   */
+/* solutions     : solutions found by the last search, 0 when deduced only    */
+/* arena         : board snapshots of the search                              */
+/*----------------------------------------------------------------------------*/
+
+struct SudokuSolver
+{
+    Sudoku sudoku;
+    Pipeline pipeline;
+    int solutions;
+    Arena arena;
+};
+
+/* cells of the units, indexed by unit and cell 0..Digits - 1 of the unit, at compile time */
+static const Cell houses[Units][Digits] =
+{
+    EachUnit(HouseRow)
+};
+
+/* the Peers cells sharing a unit with a cell, indexed by cell number, at compile time */
+static const Cell peers[Cells][Peers] =
+{
+    EachCell(PeerRow)
+};
+
+#if Box == 3
+/* the unions the group kernels test, the 9 bit masks with 3 or 4 bits, padded to 14 rows of 16 */
+static const Mask subset_unions[SubsetUnions] =
+{
+    0x007, 0x00b, 0x00d, 0x00e, 0x00f, 0x013, 0x015, 0x016, 0x017, 0x019, 0x01a, 0x01b, 0x01c, 0x01d, 0x01e, 0x023,
+    0x025, 0x026, 0x027, 0x029, 0x02a, 0x02b, 0x02c, 0x02d, 0x02e, 0x031, 0x032, 0x033, 0x034, 0x035, 0x036, 0x038,
+    0x039, 0x03a, 0x03c, 0x043, 0x045, 0x046, 0x047, 0x049, 0x04a, 0x04b, 0x04c, 0x04d, 0x04e, 0x051, 0x052, 0x053,
+    0x054, 0x055, 0x056, 0x058, 0x059, 0x05a, 0x05c, 0x061, 0x062, 0x063, 0x064, 0x065, 0x066, 0x068, 0x069, 0x06a,
+    0x06c, 0x070, 0x071, 0x072, 0x074, 0x078, 0x083, 0x085, 0x086, 0x087, 0x089, 0x08a, 0x08b, 0x08c, 0x08d, 0x08e,
+    0x091, 0x092, 0x093, 0x094, 0x095, 0x096, 0x098, 0x099, 0x09a, 0x09c, 0x0a1, 0x0a2, 0x0a3, 0x0a4, 0x0a5, 0x0a6,
+    0x0a8, 0x0a9, 0x0aa, 0x0ac, 0x0b0, 0x0b1, 0x0b2, 0x0b4, 0x0b8, 0x0c1, 0x0c2, 0x0c3, 0x0c4, 0x0c5, 0x0c6, 0x0c8,
+    0x0c9, 0x0ca, 0x0cc, 0x0d0, 0x0d1, 0x0d2, 0x0d4, 0x0d8, 0x0e0, 0x0e1, 0x0e2, 0x0e4, 0x0e8, 0x0f0, 0x103, 0x105,
+    0x106, 0x107, 0x109, 0x10a, 0x10b, 0x10c, 0x10d, 0x10e, 0x111, 0x112, 0x113, 0x114, 0x115, 0x116, 0x118, 0x119,
+    0x11a, 0x11c, 0x121, 0x122, 0x123, 0x124, 0x125, 0x126, 0x128, 0x129, 0x12a, 0x12c, 0x130, 0x131, 0x132, 0x134,
+    0x138, 0x141, 0x142, 0x143, 0x144, 0x145, 0x146, 0x148, 0x149, 0x14a, 0x14c, 0x150, 0x151, 0x152, 0x154, 0x158,
+    0x160, 0x161, 0x162, 0x164, 0x168, 0x170, 0x181, 0x182, 0x183, 0x184, 0x185, 0x186, 0x188, 0x189, 0x18a, 0x18c,
+    0x190, 0x191, 0x192, 0x194, 0x198, 0x1a0, 0x1a1, 0x1a2, 0x1a4, 0x1a8, 0x1b0, 0x1c0, 0x1c1, 0x1c2, 0x1c4, 0x1c8,
+    0x1d0, 0x1e0, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000
+};
+
+/* the bits of the unions, the padding never equal to a count of cells */
+static const Mask subset_sizes[SubsetUnions] =
+{
+    3, 3, 3, 3, 4, 3, 3, 3, 4, 3, 3, 4, 3, 4, 4, 3,
+    3, 3, 4, 3, 3, 4, 3, 4, 4, 3, 3, 4, 3, 4, 4, 3,
+    4, 4, 4, 3, 3, 3, 4, 3, 3, 4, 3, 4, 4, 3, 3, 4,
+    3, 4, 4, 3, 4, 4, 4, 3, 3, 4, 3, 4, 4, 3, 4, 4,
+    4, 3, 4, 4, 4, 4, 3, 3, 3, 4, 3, 3, 4, 3, 4, 4,
+    3, 3, 4, 3, 4, 4, 3, 4, 4, 4, 3, 3, 4, 3, 4, 4,
+    3, 4, 4, 4, 3, 4, 4, 4, 4, 3, 3, 4, 3, 4, 4, 3,
+    4, 4, 4, 3, 4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 3, 3,
+    3, 4, 3, 3, 4, 3, 4, 4, 3, 3, 4, 3, 4, 4, 3, 4,
+    4, 4, 3, 3, 4, 3, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4,
+    4, 3, 3, 4, 3, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 4,
+    3, 4, 4, 4, 4, 4, 3, 3, 4, 3, 4, 4, 3, 4, 4, 4,
+    3, 4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 3, 4, 4, 4, 4,
+    4, 4, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff
+};
+#endif
+
+/* technique names, indexed by technique */
+static const char *technique_names[Techniques] =
+{
+    "deduce_singles",
+    "deduce_block_solved",
+    "deduce_block_groups",
+    "deduce_block_exclusives",
+    "deduce_block_exclusive_groups",
+    "deduce_xline_groups",
+    "deduce_yline_groups",
+    "deduce_xline_block_groups",
+    "deduce_yline_block_groups",
+    "deduce_xline_exclusive_groups",
+    "deduce_yline_exclusive_groups",
+    "deduce_xwing_x",
+    "deduce_xwing_y",
+    "deduce_swordfish_x",
+    "deduce_swordfish_y",
+    "deduce_jellyfish_x",
+    "deduce_jellyfish_y"
+};
+
+/* the full ladder of techniques, restarting after progress, singles cover block solved and exclusives */
+static const Pipeline pipeline_full =
+{
+    Techniques - 2,
+    {
+        TechniqueSingles, TechniqueBlockGroups, TechniqueBlockExclusiveGroups,
+        TechniqueXLineGroups, TechniqueYLineGroups, TechniqueXLineBlockGroups, TechniqueYLineBlockGroups,
+        TechniqueXLineExclusiveGroups, TechniqueYLineExclusiveGroups, TechniqueXWingX, TechniqueXWingY,
+        TechniqueSwordfishX, TechniqueSwordfishY, TechniqueJellyfishX, TechniqueJellyfishY
+    },
+    1
+};
+
+/* the naked and hidden singles only */
+static const Pipeline pipeline_singles =
+{
+    1,
+    {
+        TechniqueSingles
+    },
+    0
+};
+
+/* technique weights in the difficulty score, deduce() runs them easiest first */
+static const int technique_weights[Techniques] =
+{
+    1, 1, 2, 3, 4, 5, 5, 6, 6, 7, 7, 10, 10, 12, 12, 14, 14
+};
+
+/* reason texts, indexed by reason */
+static const char *reason_names[Reasons] =
+{
+    "fill()",
+    "search()",
+    "dlx()",
+    "deduce_block_solved_cell()",
+    "deduce_block_group_block()",
+    "deduce_block_exclusive_block()",
+    "deduce_block_exclusive_group_block()",
+    "deduce_xline_group_line()",
+    "deduce_yline_group_line()",
+    "deduce_xline_block_group_block()",
+    "deduce_yline_block_group_block()",
+    "deduce_xline_exclusive_group_line()",
+    "deduce_yline_exclusive_group_line()",
+    "deduce_fish() x lines",
+    "deduce_fish() y lines",
+    "deduce_singles() naked",
+    "deduce_singles() hidden"
+};
+
+/*----------------------------------------------------------------------------*/
+/* chunks        : number of chunks read and dealt so far                     */
+/* deal          : number of chunks read per deal, FarmDeal per worker, one   */
+/*                 when generating                                            */
+/* end           : input exhausted, no chunks are dealt anymore               */
+/* flushed       : number of chunks written in order                          */
+/* line          : input line number of the last line read                    */
+/* n             : number of puzzles read                                     */
+/* taken         : number of chunks a worker took, all when equal to chunks   */
+/* window        : number of chunk slots, chunk c in slot c % window          */
+/* cursor, limit : rest of the mapped input, or NULL to read file             */
+/* deques        : per worker range of chunks, the owner takes from the head, */
+/*                 thieves steal the back half                                */
+/* done          : per slot the chunk solved in it plus 1, the reorder buffer */
+/*                 writes them in order                                       */
+/* lines         : per slot FarmChunk lines of LineSize, the puzzle read into */
+/*                 it solved in place                                         */
+/* sizes         : per slot the number of puzzles of its chunk                */
+/* cond          : signals the reorder buffer a chunk solved or the end       */
+/* room          : signals the workers slots flushed or chunks dealt          */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+}
+Deque;
+
+typedef struct
+{
+    int chunks;
+    int deal;
+    int end;
+    int flushed;
+    int jobs;
+    int line;
+    int n;
+    int taken;
+    int window;
+    Options *options;
+
+    char *cursor;
+    char *limit;
+    FILE *file;
+
+    Deque *deques;
+    int *done;
+    char *lines;
+    int *sizes;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_cond_t room;
+}
+Farm;
+
+typedef struct
+{
+    Farm *farm;
+    int id;
+    pthread_t thread;
+    Totals totals;
+}
+Worker;
+
 /* common functions */
 int all_blocks(Sudoku *s, int (*block_function)(Sudoku *s, int xb, int yb));
 int all_cells(Sudoku *s, int (*cell_function)(Sudoku *s, int xb, int yb, int xc, int yc));
+int changed_block_cells(Sudoku *s, int t, int (*cell_function)(Sudoku *s, int xb, int yb, int xc, int yc));
+int changed_blocks(Sudoku *s, int t, int (*block_function)(Sudoku *s, int xb, int yb));
+int changed_xlines(Sudoku *s, int t, int (*line_function)(Sudoku *s, int y));
+int changed_ylines(Sudoku *s, int t, int (*line_function)(Sudoku *s, int x));
 int number(int premise_bit);
 
 /* core functions */
+int batch(FILE *f, Options *o, Totals *t);
+int batch_map(char *data, size_t size, Options *o, Totals *t);
 int deduce(Sudoku *s);
-int fill(Sudoku *s);
+int deduce_profiled(Sudoku *s, int t);
+int deduce_technique(Sudoku *s, int t);
+int fill(Sudoku *s, const char *puzzle);
 int init(Sudoku *s);
-int main(void);
+int main(int argc, char *argv[]);
 int print(Sudoku *s);
+int print_bench(Totals *t, Options *o, double elapsed);
 int print_cell(Sudoku *s, int xb, int yb, int xc, int yc);
+int print_profile(Profile *p, int format);
+
+/* farm functions */
+int farm(FILE *file, char *data, size_t size, Options *o, Totals *t);
+int farm_deal(Farm *f, int id);
+int farm_read(Farm *f, char *line);
+int farm_take(Farm *f, int id);
+void *farm_worker(void *arg);
+
+/* generator functions */
+int generate(Options *o, Totals *t);
+int generate_grid(Sudoku *s, Arena *a, char *puzzle, unsigned long *seed);
+int generate_puzzle(Sudoku *s, Arena *a, long k, char *line, Options *o, Totals *t);
+unsigned long generate_random(unsigned long *seed);
+int generate_remove(Sudoku *s, Arena *a, char *puzzle, unsigned long *seed);
+
+/* input functions */
+char *map(char *filename, size_t *size);
+
+/* latency functions */
+int latency_bucket(long nanoseconds);
+long latency_percentile(long *latency, double fraction);
+
+/* ring buffer functions */
+int ring_decode(char *filename);
+int ring_init(Ring *r);
+int ring_write(Ring *r, FILE *f, int thread);
+
+/* step log functions */
+int step_begin(Steps *st, char *puzzle);
+int step_cells(Sudoku *s, int unit, int places);
+int step_clear(Sudoku *s, int xb, int yb, int xc, int yc, int p);
+int step_done(Sudoku *s, int progress);
+int step_end(Steps *st, FILE *f, char *line, int solved);
+int step_found(Sudoku *s, int mask, int unit, int places);
+int step_pattern(Sudoku *s);
+int step_printf(Steps *st, const char *format, ...);
+int step_round(Sudoku *s, int t);
+int step_token(Steps *st, int xb, int yb, int xc, int yc, int p);
+
+/* puzzle line functions */
+int parse(const char *line);
+int pipeline(Pipeline *pl, const char *spec);
+int sample(char *puzzle);
+int solution(const Sudoku *s, char *puzzle);
+int solve(Sudoku *s, char *puzzle, char *line, Options *o, Totals *t);
+int technique(const char *name, int n);
 
 /* clear functions */
-int clear_premise(Sudoku *s, int xb, int yb, int xc, int yc, int p, char *reason);
+int clear_premise(Sudoku *s, int xb, int yb, int xc, int yc, int p, int reason);
 int verify(Sudoku *s);
 int verify_block(Sudoku *s, int xb, int yb);
 int verify_cell(Sudoku *s, int xb, int yb, int xc, int yc);
 int verify_xline(Sudoku *s);
 int verify_yline(Sudoku *s);
 
+/* deduce singles functions */
+int deduce_singles(Sudoku *s);
+
 /* deduce block functions */
 int deduce_block_exclusive_block(Sudoku *s, int xb, int yb);
-int deduce_block_exclusive_group_cell(Sudoku *s, int xb, int yb, int xc, int yc);
-int deduce_block_group_cell(Sudoku *s, int xb, int yb, int xc, int yc);
+int deduce_block_exclusive_group_block(Sudoku *s, int xb, int yb);
+int deduce_block_group_block(Sudoku *s, int xb, int yb);
 int deduce_block_solved_cell(Sudoku *s, int xb, int yb, int xc, int yc);
 
 /* deduce line functions */
 int deduce_xline_block_group_block(Sudoku *s, int xb, int yb);
 int deduce_yline_block_group_block(Sudoku *s, int xb, int yb);
-int deduce_xline_group_cell(Sudoku *s, int xb, int yb, int xc, int yc);
-int deduce_yline_group_cell(Sudoku *s, int xb, int yb, int xc, int yc);
-int deduce_xline_exclusive_group_cell(Sudoku *s, int xb, int yb, int xc, int yc);
-int deduce_yline_exclusive_group_cell(Sudoku *s, int xb, int yb, int xc, int yc);
-
-/* deduce xwing functions */
-int deduce_xwing_x(Sudoku *s);
-int deduce_xwing_y(Sudoku *s);
+int deduce_xline_group_line(Sudoku *s, int y);
+int deduce_yline_group_line(Sudoku *s, int x);
+int deduce_xline_exclusive_group_line(Sudoku *s, int y);
+int deduce_yline_exclusive_group_line(Sudoku *s, int x);
+
+/* deduce group functions */
+int deduce_exclusive_group_found(Sudoku *s, int unit, int mask, int places, int reason);
+int deduce_exclusive_groups(Sudoku *s, int unit, int reason);
+int deduce_group_found(Sudoku *s, int unit, int mask, int cells, int reason);
+int deduce_groups(Sudoku *s, int unit, int reason);
+
+/* house kernel functions */
+int subsets_avx2(const Mask *masks, int size, Mask *unions);
+int subsets_scalar(const Mask *masks, int size, Mask *unions);
+int subsets_search(const Mask *masks, int size, int first, int count, int mask, Mask *unions, int n);
+int subsets_sse2(const Mask *masks, int size, Mask *unions);
+int twins_avx2(const Mask *masks, Mask *equal);
+int twins_scalar(const Mask *masks, Mask *equal);
+void twins_default(void);
+int twins_select(char *kernel);
+int twins_sse2(const Mask *masks, Mask *equal);
+
+/* deduce fish functions */
+int deduce_fish(Sudoku *s, int l, int size);
+
+/* search functions */
+int search(Sudoku *s, Arena *a, int limit);
+int search_restore(Sudoku *s, unsigned char *board, int mark);
+int state(Sudoku *s);
+int undo(Sudoku *s, int mark);
+
+/* dancing links functions */
+int dlx(Sudoku *s, Dlx *d, int limit);
+int dlx_cover(Dlx *d, int c);
+int dlx_search(Dlx *d, int k, int limit);
+int dlx_uncover(Dlx *d, int c);
+
+/* equal mask kernel for groups, per mask the masks equal to it */
+static int (*twins)(const Mask *masks, Mask *equal) = twins_scalar;
+
+/* union kernel for groups, the unions of 3 up to size masks with as many bits as masks within */
+static int (*subsets)(const Mask *masks, int size, Mask *unions) = subsets_scalar;
+
+/* the library picks the kernel once for all solvers */
+static pthread_once_t twins_once = PTHREAD_ONCE_INIT;
 
 /* sample sudokus */
 #define S1 \
@@ -207,10 +991,11 @@ int all_blocks(Sudoku *s, int (*block_function)(Sudoku *s, int xb, int yb))
     rc = 0;
 
     /* execute function on all blocks */
-    for(int xb = 0; xb < 3; xb++)
+    for(int xb = 0; xb < Box; xb++)
     {
-        for(int yb = 0; yb < 3; yb++)
+        for(int yb = 0; yb < Box; yb++)
         {
+            s -> visits += Digits;
             if(block_function(s, xb, yb))
                 rc = 1;
         }
@@ -228,14 +1013,15 @@ int all_cells(Sudoku *s, int (*cell_function)(Sudoku *s, int xb, int yb, int xc,
     rc = 0;
 
     /* execute function on all cells */
-    for(int xb = 0; xb < 3; xb++)
+    for(int xb = 0; xb < Box; xb++)
     {
-        for(int yb = 0; yb < 3; yb++)
+        for(int yb = 0; yb < Box; yb++)
         {
-            for(int xc = 0; xc < 3; xc++)
+            for(int xc = 0; xc < Box; xc++)
             {
-                for(int yc = 0; yc < 3; yc++)
+                for(int yc = 0; yc < Box; yc++)
                 {
+                    s -> visits++;
                     if(cell_function(s, xb, yb, xc, yc))
                         rc = 1;
                 }
@@ -246,118 +1032,107 @@ int all_cells(Sudoku *s, int (*cell_function)(Sudoku *s, int xb, int yb, int xc,
 }
 
 /*----------------------------------------------------------------------------*/
-/* clear_premise                                                              */
+/* batch                                                                      */
 /*----------------------------------------------------------------------------*/
-int clear_premise(Sudoku *s, int xb, int yb, int xc, int yc, int p, char *reason)
+int batch(FILE *f, Options *o, Totals *t)
 {
-    if(s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
+    int c;
+    int l;
+    int n;
+    Sudoku s;
+    char line[LineSize];
+
+    /* solve one puzzle per line, reusing the same sudoku */
+    l = 0;
+    n = 0;
+    while(fgets(line, sizeof(line), f))
     {
-        /* clear premise */
-        Trace("    clear (%3d/648) c%d%d%d%d p%d %s\n", s -> cleared + 1, xb, yb, xc, yc, p + 1, reason);
-        
-        s -> cleared++;
-        
-        s -> cell_premise[xb][yb][xc][yc] &= ~s -> premise_bit[p];
+        l++;
 
-        s -> cell_premises[xb][yb][xc][yc]--;
-        s -> block_premises[xb][yb][p]--;
-        s -> line_premises[X][yb * 3 + yc][p]--;
-        s -> line_premises[Y][xb * 3 + xc][p]--;
+        /* drop the rest of a line longer than the buffer, one line as the mapped input reads it */
+        if(!strchr(line, '\n'))
+            while((c = getc(f)) != EOF && c != '\n');
 
-        #ifdef __TRACE__
-            /* check integrity */
-            verify(s);
-        #endif
+        /* skip empty and comment lines */
+        if(line[0] == '\n' || line[0] == '\r' || line[0] == '#')
+            continue;
+        if(!parse(line))
+        {
+            fprintf(stderr, "Invalid puzzle at line %d\n", l);
+            continue;
+        }
 
-        return 1;
+        solve(&s, line, line, o, t);
+        fputs(line, stdout);
+        n++;
     }
-    return 0;
+    return n;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce                                                                     */
+/* batch_map                                                                  */
 /*----------------------------------------------------------------------------*/
-int deduce(Sudoku *s)
+int batch_map(char *data, size_t size, Options *o, Totals *t)
 {
-    Trace("deduce()\n");
-
-    /* deduce blocks */
-    Trace("deduce_block_solved()\n");
-    if(all_cells(s, deduce_block_solved_cell))
-        return 1;
-    Trace("deduce_block_groups()\n");
-    if(all_cells(s, deduce_block_group_cell))
-        return 1;
-    Trace("deduce_block_exclusives()\n");
-    if(all_blocks(s, deduce_block_exclusive_block))
-        return 1;
-    Trace("deduce_block_exclusive_groups()\n");
-    if(all_cells(s, deduce_block_exclusive_group_cell))
-        return 1;
+    int l;
+    int n;
+    char *end;
+    char *next;
+    char *p;
+    Sudoku s;
+    char line[LineSize];
 
-    /* deduce lines */
-    Trace("deduce_xline_groups()\n");
-    if(all_cells(s, deduce_xline_group_cell))
-        return 1;
-    Trace("deduce_yline_groups()\n");
-    if(all_cells(s, deduce_yline_group_cell))
-        return 1;
-    Trace("deduce_xline_block_groups()\n");
-    if(all_blocks(s, deduce_xline_block_group_block))
-        return 1;
-    Trace("deduce_yline_block_groups()\n");
-    if(all_blocks(s, deduce_yline_block_group_block))
-        return 1;
-    Trace("deduce_xline_exclusive_groups()\n");
-    if(all_cells(s, deduce_xline_exclusive_group_cell))
-        return 1;
-    Trace("deduce_yline_exclusive_groups()\n");
-    if(all_cells(s, deduce_yline_exclusive_group_cell))
-        return 1;   
+    /* parse the records in place, no copy of the puzzle line */
+    l = 0;
+    n = 0;
+    end = data + size;
+    for(p = data; p < end; p = next)
+    {
+        next = memchr(p, '\n', end - p);
+        next = next ? next + 1 : end;
+        l++;
 
-    /* deduce x-wings */
-    if(deduce_xwing_x(s))
-        return 1;
-    if(deduce_xwing_y(s))
-        return 1;
+        /* skip empty and comment lines */
+        if(*p == '\n' || *p == '\r' || *p == '#')
+            continue;
+        if(next - p < Cells || !parse(p))
+        {
+            fprintf(stderr, "Invalid puzzle at line %d\n", l);
+            continue;
+        }
 
-    return 0;
+        solve(&s, p, line, o, t);
+        fputs(line, stdout);
+        n++;
+    }
+    return n;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_block_exclusive_block                                               */
+/* changed_block_cells                                                        */
 /*----------------------------------------------------------------------------*/
-int deduce_block_exclusive_block(Sudoku *s, int xb, int yb)
+int changed_block_cells(Sudoku *s, int t, int (*cell_function)(Sudoku *s, int xb, int yb, int xc, int yc))
 {
     int rc;
 
     rc = 0;
 
-    /* find premise unique in block */
-    for(int p = 0; p < 9; p++)
+    /* execute function on the cells of blocks changed since its last run */
+    for(int xb = 0; xb < Box; xb++)
     {
-        /* check if this is a block exclusive */
-        if(s -> block_premises[xb][yb][p] == 1)
+        for(int yb = 0; yb < Box; yb++)
         {
-            Trace("  found b%d%d p%d\n", xb, yb, p + 1);
+            if(s -> seen[t][UnitBlock(xb, yb)] >= s -> changed[UnitBlock(xb, yb)])
+                continue;
+            s -> seen[t][UnitBlock(xb, yb)] = s -> cleared;
 
-            /* we found an excusive cell within the block */
-            for(int xc = 0; xc < 3; xc++)
+            for(int xc = 0; xc < Box; xc++)
             {
-                for(int yc = 0; yc < 3; yc++)
+                for(int yc = 0; yc < Box; yc++)
                 {
-                    /* make it also a cell exclusive */
-                    if(s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
-                    {
-                        for(int p2 = 0; p2 < 9; p2++)
-                        {
-                            if(p2 != p)
-                            {
-                                if(clear_premise(s, xb, yb, xc, yc, p2, "deduce_block_exclusive_block()"))
-                                    rc = 1;
-                            }
-                        }
-                    }
+                    s -> visits++;
+                    if(cell_function(s, xb, yb, xc, yc))
+                        rc = 1;
                 }
             }
         }
@@ -366,567 +1141,592 @@ int deduce_block_exclusive_block(Sudoku *s, int xb, int yb)
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_block_solved_cell                                                   */
+/* changed_blocks                                                             */
 /*----------------------------------------------------------------------------*/
-int deduce_block_solved_cell(Sudoku *s, int xb, int yb, int xc, int yc)
+int changed_blocks(Sudoku *s, int t, int (*block_function)(Sudoku *s, int xb, int yb))
 {
-    int p;
     int rc;
 
-    /* return if not deduced */
-    if(s -> cell_premises[xb][yb][xc][yc] != 1)
-        return 0;
-
-    /* clear deduced number in other block cells */
-    p = number(s -> cell_premise[xb][yb][xc][yc]);
     rc = 0;
 
-    Trace("  found c%d%d%d%d p%d\n", xb, yb, xc, yc, p + 1);
-
-    /* clear other cells in block */
-    for(int x = 0; x < 3; x++)
+    /* execute function on blocks changed since its last run */
+    for(int xb = 0; xb < Box; xb++)
     {
-        for(int y = 0; y < 3; y++)
+        for(int yb = 0; yb < Box; yb++)
         {
-            /* not yourself! */
-            if(x == xc && y == yc)
+            if(s -> seen[t][UnitBlock(xb, yb)] >= s -> changed[UnitBlock(xb, yb)])
                 continue;
-            if(clear_premise(s, xb, yb, x, y, p, "deduce_block_solved_cell()"))
+            s -> seen[t][UnitBlock(xb, yb)] = s -> cleared;
+
+            s -> visits += Digits;
+            if(block_function(s, xb, yb))
                 rc = 1;
         }
     }
-
     return rc;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_xline_block_group_block                                             */
+/* changed_xlines                                                             */
 /*----------------------------------------------------------------------------*/
-int deduce_xline_block_group_block(Sudoku *s, int xb, int yb)
+int changed_xlines(Sudoku *s, int t, int (*line_function)(Sudoku *s, int y))
 {
-    int l;
     int rc;
-    int yc;
 
     rc = 0;
 
-    /* find unique premises within the block x line  */
-    for(int p = 0; p < 9; p++)
+    /* execute function on x lines changed since its last run */
+    for(int y = 0; y < Digits; y++)
     {
-        l = -1;
-        for(yc = 0; yc < 3; yc++)
-        {
-            for(int xc = 0; xc < 3; xc++)
-            {
-                if(s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
-                {
-                    if(l == -1)
-                    {
-                        l = yc;
-                        break;
-                    }
-                    else
-                    {
-                        l = -2;
-                        break;
-                    }
-                }
-            }
-            if(l == -2)
-                break;
-        }
-        if(l < 0)
+        if(s -> seen[t][UnitXLine(y)] >= s -> changed[UnitXLine(y)])
             continue;
+        s -> seen[t][UnitXLine(y)] = s -> cleared;
 
-        Trace("  found b%d%d p%d y%d\n", xb, yb, p + 1, l);
-
-        /* found double clear these in other cells */
-        for(int i = 0; i < 9; i++)
-        {
-            if(xb == i / 3)
-                continue;
-            
-            if(clear_premise(s, i / 3, yb, i % 3, l, p, "deduce_xline_block_group_block()"))
-                rc = 1;
-        }
+        s -> visits += Digits;
+        if(line_function(s, y))
+            rc = 1;
     }
-
     return rc;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_yline_block_group_block                                             */
+/* changed_ylines                                                             */
 /*----------------------------------------------------------------------------*/
-int deduce_yline_block_group_block(Sudoku *s, int xb, int yb)
+int changed_ylines(Sudoku *s, int t, int (*line_function)(Sudoku *s, int x))
 {
-    int l;
     int rc;
 
     rc = 0;
 
-    /* find unique premises within the block y line  */
-    for(int p = 0; p < 9; p++)
+    /* execute function on y lines changed since its last run */
+    for(int x = 0; x < Digits; x++)
     {
-        l = -1;
-        for(int xc = 0; xc < 3; xc++)
-        {
-            for(int yc = 0; yc < 3; yc++)
-            {
-                if(s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
-                {
-                    if(l == -1)
-                    {
-                        l = xc;
-                        break;
-                    }
-                    else
-                    {
-                        l = -2;
-                        break;
-                    }
-                }
-            }
-            if(l == -2)
-                break;
-        }
-        if(l < 0)
+        if(s -> seen[t][UnitYLine(x)] >= s -> changed[UnitYLine(x)])
             continue;
+        s -> seen[t][UnitYLine(x)] = s -> cleared;
 
-        Trace("  found b%d%d p%d x%d\n", xb, yb, p + 1, l);
-
-        /* found double clear these in other cells */
-        for(int i = 0; i < 9; i++)
-        {
-            if(yb == i / 3)
-                continue;
-            if(clear_premise(s, xb, i / 3, l, i % 3, p, "deduce_yline_block_group_block()"))
-                rc = 1;
-        }
+        s -> visits += Digits;
+        if(line_function(s, x))
+            rc = 1;
     }
-
     return rc;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_block_exclusive_group_cell                                          */
+/* clear_premise                                                              */
 /*----------------------------------------------------------------------------*/
-int deduce_block_exclusive_group_cell(Sudoku *s, int xb, int yb, int xc, int yc)
+int clear_premise(Sudoku *s, int xb, int yb, int xc, int yc, int p, int reason)
 {
-    int c;
-    int mask;
-    int rc;
-
-    rc = 0;
+    /* stop clearing once contradicted, the puzzle has no solution */
+    if(s -> contradiction)
+        return 0;
 
-    /* find group unique premises within block */
-    for(int size = 2; size < 8; size++)
+    if(s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
     {
-        c = 0;
-        mask = 0;
-        for(int p = 0; p < 9; p++)
+        /* clear premise */
+        Trace("    clear (%3d/%d) c%d%d%d%d p%d %s\n", s -> cleared + 1, Premises - Cells, xb, yb, xc, yc, p + 1, reason_names[reason]);
+        
+        s -> cleared++;
+        s -> eliminations++;
+
+        /* record the binary event */
+        if(s -> ring)
         {
-            if(s -> block_premises[xb][yb][p] == size && s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
-            {
-                mask |= s -> premise_bit[p];
-                c++;
-            }
+            Event *e = &s -> ring -> events[s -> ring -> head++ & (RingEvents - 1)];
+
+            e -> cleared = s -> cleared;
+            e -> reason = reason;
+            e -> cell = CellNumber(xb, yb, xc, yc);
+            e -> premise = p;
         }
-        if(c != size)
-            continue;
+        if(s -> steps)
+            step_clear(s, xb, yb, xc, yc, p);
+        if(s -> trail)
+            s -> trail -> clears[s -> trail -> tail++] = CellNumber(xb, yb, xc, yc) * Digits + p;
+        
+        s -> cell_premise[xb][yb][xc][yc] &= ~s -> premise_bit[p];
+
+        #ifndef __POPCOUNT__
+            s -> cell_premises[xb][yb][xc][yc]--;
+            s -> block_premises[xb][yb][p]--;
+            s -> line_premises[X][yb * Box + yc][p]--;
+            s -> line_premises[Y][xb * Box + xc][p]--;
+        #endif
 
-        /* does the group exist */
-        c = 0;
-        for(int xc2 = xc; xc2 < 3; xc2++)
+        s -> block_places[xb][yb][p] &= ~(1 << (xc * Box + yc));
+        s -> line_places[X][yb * Box + yc][p] &= ~(1 << (xb * Box + xc));
+        s -> line_places[Y][xb * Box + xc][p] &= ~(1 << (yb * Box + yc));
+
+        /* queue the singles for deduce_singles() */
+        if(CellPremises(s, xb, yb, xc, yc) == 1)
+            s -> queue[s -> queue_tail++] = CellNumber(xb, yb, xc, yc);
+        if(BlockPremises(s, xb, yb, p) == 1)
+            s -> queue[s -> queue_tail++] = Cells + UnitBlock(xb, yb) * Digits + p;
+        if(LinePremises(s, X, yb * Box + yc, p) == 1)
+            s -> queue[s -> queue_tail++] = Cells + UnitXLine(yb * Box + yc) * Digits + p;
+        if(LinePremises(s, Y, xb * Box + xc, p) == 1)
+            s -> queue[s -> queue_tail++] = Cells + UnitYLine(xb * Box + xc) * Digits + p;
+
+        /* a cell without premise or a premise without place in a unit is a contradiction */
+        if(CellPremises(s, xb, yb, xc, yc) == 0 || BlockPremises(s, xb, yb, p) == 0 ||
+           LinePremises(s, X, yb * Box + yc, p) == 0 || LinePremises(s, Y, xb * Box + xc, p) == 0)
         {
-            for(int yc2 = yc; yc2 < 3; yc2++)
-            {
-                if((s -> cell_premise[xb][yb][xc2][yc2] & mask) == mask)
-                    c++;
-            }
+            Trace("    contradiction c%d%d%d%d p%d\n", xb, yb, xc, yc, p + 1);
+            s -> contradiction = s -> cleared;
         }
-        if(c != size)
-            continue;
+
+        /* mark the units of the cell changed */
+        s -> changed[UnitBlock(xb, yb)] = s -> cleared;
+        s -> changed[UnitXLine(yb * Box + yc)] = s -> cleared;
+        s -> changed[UnitYLine(xb * Box + xc)] = s -> cleared;
 
         #ifdef __TRACE__
-        {
-            int first;
-        
-            first = 1;
-            printf("  found c%d%d%d%d ", xb, yb, xc, yc);
-            for(int p = 0; p < 9; p++)
-            {
-                if(mask & s -> premise_bit[p])
-                {
-                    if(first)
-                    {
-                        printf("p%d", p + 1);
-                        first = 0;
-                    }
-                    else printf("-p%d", p + 1);
-                }
-            }
-            printf("\n");
-        }
+            /* check integrity */
+            verify(s);
         #endif
 
-        for(int xc2 = 0; xc2 < 3; xc2++)
-        {
-            for(int yc2 = 0; yc2 < 3; yc2++)
-            {
-                /* skip solved ones */
-                if(s -> cell_premises[xb][yb][xc2][yc2] == 1)
-                    continue;
-
-                /* clear premises */
-                for(int p = 0; p < 9; p++)
-                {
-                    if((s -> cell_premise[xb][yb][xc2][yc2] & mask) == mask)
-                    {
-                        /* clear non group premises within group members */
-                        if(!(mask & s -> premise_bit[p]))
-                        {
-                            if(clear_premise(s, xb, yb, xc2, yc2, p, "deduce_block_exclusive_group_cell() group member"))
-                                rc = 1;
-                        }                        
-                    }
-                    else
-                    {
-                        /* clear group premises within non group members */
-                        if(mask & s -> premise_bit[p])
-                        {
-                            if(clear_premise(s, xb, yb, xc2, yc2, p, "deduce_block_exclusive_group_cell() non group member"))
-                                rc = 1;
-                        }
-                    }
-                }
-            }
-        }
+        return 1;
     }
-    return rc;
+    return 0;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_block_group_cell                                                    */
+/* deduce                                                                     */
 /*----------------------------------------------------------------------------*/
-int deduce_block_group_cell(Sudoku *s, int xb, int yb, int xc, int yc)
+int deduce(Sudoku *s)
 {
-    int c;
-    int mask;
+    int n;
+    int progress;
     int rc;
+    int t;
 
-    /* skip solved cells */
-    if(s -> cell_premises[xb][yb][xc][yc] == 1)
-        return 0;
+    Trace("deduce()\n");
 
-    /* find group premises within block */
-    c = 0;
-    mask = s -> cell_premise[xb][yb][xc][yc];
-    for(int xc2 = xc; xc2 < 3; xc2++)
+    /* run the techniques of the pipeline in order, restart after progress or go on */
+    progress = 0;
+    for(int i = 0; i < s -> pipeline -> techniques; i++)
     {
-        for(int yc2 = yc; yc2 < 3; yc2++)
+        t = s -> pipeline -> order[i];
+        if(s -> steps)
+            step_round(s, t);
+        rc = s -> profile ? deduce_profiled(s, t) : deduce_technique(s, t);
+        if(s -> steps)
+            step_done(s, rc);
+        if(s -> contradiction)
+            return 0;
+        if(rc)
         {
-            if(mask == s -> cell_premise[xb][yb][xc2][yc2])
-                c++;
+            /* the singles count a round per wave, as a sweep over the board did */
+            n = t == TechniqueSingles ? s -> waves : 1;
+            s -> rounds += n;
+            s -> score += n * technique_weights[t];
+            if(t > s -> hardest)
+                s -> hardest = t;
+            if(s -> pipeline -> restart)
+                return 1;
+            progress = 1;
         }
     }
+    return progress;
+}
 
-    /* check if this is a group */
-    if(s -> cell_premises[xb][yb][xc][yc] != c)
-        return 0;
+/*----------------------------------------------------------------------------*/
+/* deduce_profiled                                                            */
+/*----------------------------------------------------------------------------*/
+int deduce_profiled(Sudoku *s, int t)
+{
+    int cleared;
+    int rc;
+    long visits;
+    struct timespec start;
+    struct timespec stop;
+
+    /* run the technique and count what it costs and what it clears */
+    cleared = s -> cleared;
+    visits = s -> visits;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rc = deduce_technique(s, t);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    s -> profile -> runs[t]++;
+    s -> profile -> visits[t] += s -> visits - visits;
+    s -> profile -> fired[t] += rc;
+    s -> profile -> cleared[t] += s -> cleared - cleared;
+    s -> profile -> nanoseconds[t] += (stop.tv_sec - start.tv_sec) * 1000000000L + stop.tv_nsec - start.tv_nsec;
+    return rc;
+}
 
-    #ifdef __TRACE__
+/*----------------------------------------------------------------------------*/
+/* deduce_technique                                                           */
+/*----------------------------------------------------------------------------*/
+int deduce_technique(Sudoku *s, int t)
+{
+    Trace("%s()\n", technique_names[t]);
+
+    switch(t)
     {
-        int first;
-    
-        first = 1;
-        printf("  found c%d%d%d%d ", xb, yb, xc, yc);
-        for(int p = 0; p < 9; p++)
+        /* propagate the singles queued by clear_premise() */
+        case TechniqueSingles:
+            return deduce_singles(s);
+
+        /* deduce blocks */
+        case TechniqueBlockSolved:
+            return changed_block_cells(s, t, deduce_block_solved_cell);
+        case TechniqueBlockGroups:
+            return changed_blocks(s, t, deduce_block_group_block);
+        case TechniqueBlockExclusives:
+            return changed_blocks(s, t, deduce_block_exclusive_block);
+        case TechniqueBlockExclusiveGroups:
+            return changed_blocks(s, t, deduce_block_exclusive_group_block);
+
+        /* deduce lines */
+        case TechniqueXLineGroups:
+            return changed_xlines(s, t, deduce_xline_group_line);
+        case TechniqueYLineGroups:
+            return changed_ylines(s, t, deduce_yline_group_line);
+        case TechniqueXLineBlockGroups:
+            return changed_blocks(s, t, deduce_xline_block_group_block);
+        case TechniqueYLineBlockGroups:
+            return changed_blocks(s, t, deduce_yline_block_group_block);
+        case TechniqueXLineExclusiveGroups:
+            return changed_xlines(s, t, deduce_xline_exclusive_group_line);
+        case TechniqueYLineExclusiveGroups:
+            return changed_ylines(s, t, deduce_yline_exclusive_group_line);
+
+        /* deduce fish of size 2 up to 4, these depend on all lines so rerun on any change */
+        case TechniqueXWingX:
+        case TechniqueXWingY:
+        case TechniqueSwordfishX:
+        case TechniqueSwordfishY:
+        case TechniqueJellyfishX:
+        case TechniqueJellyfishY:
+            if(s -> seen[t][0] >= s -> cleared)
+                return 0;
+            s -> seen[t][0] = s -> cleared;
+            return deduce_fish(s, (t - TechniqueXWingX) % 2 == 0 ? X : Y, 2 + (t - TechniqueXWingX) / 2);
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* deduce_exclusive_group_found                                               */
+/*----------------------------------------------------------------------------*/
+int deduce_exclusive_group_found(Sudoku *s, int unit, int mask, int places, int reason)
+{
+    int rc;
+    const Cell *cell;
+
+    Trace("  found u%d", unit);
+    for(int p = 0; p < Digits; p++)
+    {
+        if(mask & s -> premise_bit[p])
         {
-            if(mask & s -> premise_bit[p])
-            {
-                if(first)
-                {
-                    printf("p%d", p + 1);
-                    first = 0;
-                }
-                else printf("-p%d", p + 1);
-            }
+            Trace(" p%d", p + 1);
         }
-        printf("\n");
     }
-    #endif
+    Trace("\n");
+    if(s -> steps)
+        step_found(s, mask, unit, places);
 
-    /* clear the group premises in other cells */
+    /* the premises of mask fill the places, their cells lose the others */
     rc = 0;
-    for(int xc2 = 0; xc2 < 3; xc2++)
+    for(int i = 0; i < Digits; i++)
     {
-        for(int yc2 = 0; yc2 < 3; yc2++)
+        if(!(places & (1 << i)))
+            continue;
+        cell = &houses[unit][i];
+        for(int p = 0; p < Digits; p++)
         {
-            /* skip solved ones */
-            if(s -> cell_premises[xb][yb][xc2][yc2] == 1)
-                continue;
-
-            /* skip cells part of the group */
-            if(s -> cell_premise[xb][yb][xc2][yc2] == mask)
-                continue;
-
-            /* clear premises */
-            for(int p = 0; p < 9; p++)
-            {
-                if(mask & s -> premise_bit[p])
-                {
-                    if(clear_premise(s, xb, yb, xc2, yc2, p, "deduce_block_group_cell()"))
-                        rc = 1;
-                }
-            }
+            if(!(mask & s -> premise_bit[p]) && clear_premise(s, cell -> xb, cell -> yb, cell -> xc, cell -> yc, p, reason))
+                rc = 1;
         }
     }
-
     return rc;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_xline_exclusive_group_cell                                          */
+/* deduce_exclusive_groups                                                    */
 /*----------------------------------------------------------------------------*/
-int deduce_xline_exclusive_group_cell(Sudoku *s, int xb, int yb, int xc, int yc)
+int deduce_exclusive_groups(Sudoku *s, int unit, int reason)
 {
-    int c;
+    int done;
     int mask;
+    int n;
+    int open;
     int rc;
-   
+    int size;
+    Mask places[Digits];
+    Mask equal[Digits];
+    Mask sets[Digits];
+    Mask unions[SubsetUnions];
 
-    /* skip solved cells */
-    if(s -> cell_premises[xb][yb][xc][yc] == 1)
-        return 0;
-    
-    /* find group unique premises within x line */
+    /* the places of the premises within the unit, equal ones in one pass */
+    memcpy(places, unit < Digits ? s -> block_places[unit / Box][unit % Box] : s -> line_places[unit < 2 * Digits ? X : Y][(unit - Digits) % Digits], sizeof(places));
+    twins(places, equal);
+
+    /* n premises on the same n places form a group, its cells lose the others */
     rc = 0;
+    done = 0;
+    for(int p = 0; p < Digits; p++)
+    {
+        if(done & (1 << p))
+            continue;
+        done |= equal[p];
+        n = __builtin_popcount(places[p]);
+        if(n < 2 || n != __builtin_popcount(equal[p]))
+            continue;
+        if(deduce_exclusive_group_found(s, unit, equal[p], places[p], reason))
+            rc = 1;
+    }
 
-    /* test all sizes, skip 1 and 9 */
-    for(int size = 2; size < 9; size++)
+    /* n premises on n places between them form a group too, as {12} {23} {13}, up to GroupSize and */
+    /* half the open ones, a larger group leaves a smaller complement group of the other kind, the */
+    /* kernel finds their unions with the placed premises left out */
+    open = 0;
+    for(int p = 0; p < Digits; p++)
+    {
+        open += __builtin_popcount(places[p]) >= 2;
+        sets[p] = __builtin_popcount(places[p]) < 2 ? AllPremiseBitsOn : places[p];
+    }
+    size = open / 2 < GroupSize ? open / 2 : GroupSize;
+    n = size >= 3 ? subsets(sets, size, unions) : 0;
+    for(int k = 0; k < n; k++)
     {
-        c = 0;
         mask = 0;
-        for(int p = 0; p < 9; p++)
+        for(int p = 0; p < Digits; p++)
         {
-            if(s -> line_premises[X][yb * 3 + yc][p] == size && s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
-            {
-                mask |= s -> premise_bit[p];
-                c++;
-            }
+            if(!(sets[p] & ~unions[k]))
+                mask |= 1 << p;
         }
-        if(c != size)
-            continue;
+        if(deduce_exclusive_group_found(s, unit, mask, unions[k], reason))
+            rc = 1;
+    }
+    return rc;
+}
 
-        /* does the group exist */
-        c= 0;
-        for(int x = xb * 3 + xc; x < 9; x++)
-        {
-            if((s -> cell_premise[x / 3][yb][x % 3][yc] & mask) == mask)
-                c++;
-        }
-        if(c != size)
-            continue;
+/*----------------------------------------------------------------------------*/
+/* deduce_group_found                                                         */
+/*----------------------------------------------------------------------------*/
+int deduce_group_found(Sudoku *s, int unit, int mask, int cells, int reason)
+{
+    int rc;
+    const Cell *cell;
 
-        #ifdef __TRACE__
+    Trace("  found u%d", unit);
+    for(int p = 0; p < Digits; p++)
+    {
+        if(mask & s -> premise_bit[p])
         {
-            int first;
-        
-            first = 1;
-            printf("  found c%d%d%d%d ", xb, yb, xc, yc);
-            for(int p = 0; p < 9; p++)
-            {
-                if(mask & s -> premise_bit[p])
-                {
-                    if(first)
-                    {
-                        printf("p%d", p + 1);
-                        first = 0;
-                    }
-                    else printf("-p%d", p + 1);
-                }
-            }
-            printf("\n");
+            Trace(" p%d", p + 1);
         }
-        #endif
+    }
+    Trace("\n");
+    if(s -> steps)
+        step_found(s, mask, unit, cells);
 
-        for(int x = 0; x < 9; x++)
+    /* the cells take the premises of mask, the other cells lose them */
+    rc = 0;
+    cell = houses[unit];
+    for(int j = 0; j < Digits; j++)
+    {
+        if(cells & (1 << j) || !(s -> cell_premise[cell[j].xb][cell[j].yb][cell[j].xc][cell[j].yc] & mask))
+            continue;
+        for(int p = 0; p < Digits; p++)
         {
-            /* skip solved ones */
-            if(s -> cell_premises[x / 3][yb][x % 3][yc] == 1)
-                continue;
-
-            /* clear premises */
-            for(int p = 0; p < 9; p++)
-            {
-                if((s -> cell_premise[x / 3][yb][x % 3][yc] & mask) == mask)
-                {
-                    /* clear non group premises within group members */
-                    if(!(mask & s -> premise_bit[p]))
-                    {
-                        if(clear_premise(s, x / 3, yb, x % 3, yc, p, "deduce_xline_exclusive_group_cell() group member"))
-                            rc = 1;
-                    }                        
-                }
-                else
-                {
-                    /* clear group premises within non group members */
-                    if(mask & s -> premise_bit[p])
-                    {
-                        if(clear_premise(s, x / 3, yb, x % 3, yc, p, "deduce_xline_exclusive_group_cell() non group member"))
-                            rc = 1;
-                    }
-                }
-            }
+            if(mask & s -> premise_bit[p] && clear_premise(s, cell[j].xb, cell[j].yb, cell[j].xc, cell[j].yc, p, reason))
+                rc = 1;
         }
     }
     return rc;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_xline_groups                                                        */
+/* deduce_groups                                                              */
 /*----------------------------------------------------------------------------*/
-int deduce_xline_group_cell(Sudoku *s, int xb, int yb, int xc, int yc)
+int deduce_groups(Sudoku *s, int unit, int reason)
 {
-    int c;
+    int done;
     int mask;
+    int n;
+    int open;
     int rc;
-
-    /* skip solved cells */
-    if(s -> cell_premises[xb][yb][xc][yc] == 1)
-        return 0;
-
-    /* find group premises within x line */
-    c = 0;
-    mask = s -> cell_premise[xb][yb][xc][yc];
-    for(int x = xb * 3 + xc; x < 9; x++)
+    int size;
+    const Cell *cell;
+    Mask masks[Digits];
+    Mask equal[Digits];
+    Mask sets[Digits];
+    Mask unions[SubsetUnions];
+
+    /* the premises of the cells within the unit, equal ones in one pass */
+    cell = houses[unit];
+    for(int i = 0; i < Digits; i++)
+        masks[i] = s -> cell_premise[cell[i].xb][cell[i].yb][cell[i].xc][cell[i].yc];
+    twins(masks, equal);
+
+    /* n cells with the same n premises form a group, the other cells lose them */
+    rc = 0;
+    done = 0;
+    for(int i = 0; i < Digits; i++)
     {
-        if(mask == s -> cell_premise[x / 3][yb][x % 3][yc])
-            c++;
+        if(done & (1 << i))
+            continue;
+        done |= equal[i];
+        mask = masks[i];
+        if(__builtin_popcount(mask) < 2 || __builtin_popcount(mask) != __builtin_popcount(equal[i]))
+            continue;
+        if(deduce_group_found(s, unit, mask, equal[i], reason))
+            rc = 1;
     }
 
-    /* check if this is a group */
-    if(s -> cell_premises[xb][yb][xc][yc] != c)
-        return 0;
-
-    #ifdef __TRACE__
+    /* n cells with n premises between them form a group too, as {12} {23} {13}, up to GroupSize and */
+    /* half the open ones, a larger group leaves a smaller complement group of the other kind, the */
+    /* kernel finds their unions with the solved cells left out */
+    open = 0;
+    for(int i = 0; i < Digits; i++)
     {
-        int first;
-    
-        first = 1;
-        printf("  found cx%dx%d ", yb, yc);
-        for(int p = 0; p < 9; p++)
+        open += __builtin_popcount(masks[i]) >= 2;
+        sets[i] = __builtin_popcount(masks[i]) < 2 ? AllPremiseBitsOn : masks[i];
+    }
+    size = open / 2 < GroupSize ? open / 2 : GroupSize;
+    n = size >= 3 ? subsets(sets, size, unions) : 0;
+    for(int k = 0; k < n; k++)
+    {
+        mask = 0;
+        for(int i = 0; i < Digits; i++)
         {
-            if(mask & s -> premise_bit[p])
-            {
-                if(first)
-                {
-                    printf("p%d", p + 1);
-                    first = 0;
-                }
-                else printf("-p%d", p + 1);
-            }
+            if(!(sets[i] & ~unions[k]))
+                mask |= 1 << i;
         }
-        printf("\n");
+        if(deduce_group_found(s, unit, unions[k], mask, reason))
+            rc = 1;
     }
-    #endif
+    return rc;
+}
+
+/*----------------------------------------------------------------------------*/
+/* deduce_singles                                                             */
+/*----------------------------------------------------------------------------*/
+int deduce_singles(Sudoku *s)
+{
+    int p;
+    int places;
+    int q;
+    int cleared;
+    int rc;
+    int tail;
+    int u;
+    int xb;
+    int yb;
+    int xc;
+    int yc;
+    const Cell *cell;
 
-    /* clear the group premises in other cells */
+    /* propagate the queued singles to a fixpoint, the clears queue new ones */
     rc = 0;
-    for(int x = 0; x < 9; x++)
+    s -> waves = 0;
+    cleared = s -> cleared;
+    tail = s -> queue_tail;
+    while(s -> queue_head < s -> queue_tail && !s -> contradiction)
     {
-         /* skip solved ones */
-         if(s -> cell_premises[x / 3][yb][x % 3][yc] == 1)
-             continue;
+        /* a wave ends with the singles queued before it started, count it for the grade when it cleared */
+        if(s -> queue_head == tail)
+        {
+            s -> waves += s -> cleared > cleared;
+            cleared = s -> cleared;
+            tail = s -> queue_tail;
+        }
+        q = s -> queue[s -> queue_head++];
+        if(q < Cells)
+        {
+            /* naked single, clear its premise in the peers */
+            xb = q / (Box * Digits);
+            yb = q / Digits % Box;
+            xc = q / Box % Box;
+            yc = q % Box;
+            if(CellPremises(s, xb, yb, xc, yc) != 1)
+                continue;
+            p = number(s -> cell_premise[xb][yb][xc][yc]);
 
-          /* skip cells part of the group */
-          if(s -> cell_premise[x / 3][yb][x % 3][yc] == mask)
-              continue;
+            Trace("  found c%d%d%d%d p%d\n", xb, yb, xc, yc, p + 1);
+            if(s -> steps)
+                step_found(s, s -> premise_bit[p], UnitBlock(xb, yb), 1 << (xc * Box + yc));
 
-        /* clear premises */
-        for(int p = 0; p < 9; p++)
-        {
-            if(mask & s -> premise_bit[p])
+            cell = peers[q];
+            s -> visits += Peers;
+            for(int k = 0; k < Peers; k++)
             {
-                if(clear_premise(s, x / 3, yb, x % 3, yc, p, "deduce_xline_group_cell()"))
+                /* most peers lost the premise already, skip the call */
+                if(s -> cell_premise[cell[k].xb][cell[k].yb][cell[k].xc][cell[k].yc] & s -> premise_bit[p] &&
+                   clear_premise(s, cell[k].xb, cell[k].yb, cell[k].xc, cell[k].yc, p, ReasonNakedSingle))
                     rc = 1;
+            }
         }
+        else
+        {
+            /* hidden single, clear the other premises of its one place */
+            u = (q - Cells) / Digits;
+            p = (q - Cells) % Digits;
+            places = u < Digits ? s -> block_places[u / Box][u % Box][p] : s -> line_places[u < 2 * Digits ? X : Y][(u - Digits) % Digits][p];
+            if(__builtin_popcount(places) != 1)
+                continue;
+            cell = &houses[u][__builtin_ctz(places)];
+            if(CellPremises(s, cell -> xb, cell -> yb, cell -> xc, cell -> yc) == 1)
+                continue;
+
+            Trace("  found u%d c%d%d%d%d p%d\n", u, cell -> xb, cell -> yb, cell -> xc, cell -> yc, p + 1);
+            if(s -> steps)
+                step_found(s, s -> premise_bit[p], u, places);
+
+            s -> visits++;
+            for(int p2 = 0; p2 < Digits; p2++)
+            {
+                if(p2 != p && s -> cell_premise[cell -> xb][cell -> yb][cell -> xc][cell -> yc] & s -> premise_bit[p2] &&
+                   clear_premise(s, cell -> xb, cell -> yb, cell -> xc, cell -> yc, p2, ReasonHiddenSingle))
+                    rc = 1;
+            }
         }
     }
-
+    s -> waves += s -> cleared > cleared;
     return rc;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_xwing_x                                                             */
+/* deduce_block_exclusive_block                                               */
 /*----------------------------------------------------------------------------*/
-int deduce_xwing_x(Sudoku *s)
+int deduce_block_exclusive_block(Sudoku *s, int xb, int yb)
 {
-    int i;
     int rc;
-    int xw[6];
-
-    Trace("deduce_xwing_x()\n");
 
     rc = 0;
-    for(int p = 0; p < 9; p++)
+
+    /* find premise unique in block */
+    for(int p = 0; p < Digits; p++)
     {
-        for(int y1 = 0; y1 < 9; y1++)
+        /* check if this is a block exclusive */
+        if(BlockPremises(s, xb, yb, p) == 1)
         {
-            if(s -> line_premises[X][y1][p] == 2)
-            {
-                /* find first line positions */
-                xw[0] = y1;
-                i = 1;
-                for(int x1 = 0; x1 < 9; x1++)
-                {
-                    if(s -> cell_premise[x1 / 3][y1 / 3][x1 % 3][y1 % 3] & s->premise_bit[p])
-                        xw[i++] = x1;
-                }
+            Trace("  found b%d%d p%d\n", xb, yb, p + 1);
+            if(s -> steps)
+                step_found(s, s -> premise_bit[p], UnitBlock(xb, yb), s -> block_places[xb][yb][p]);
 
-                /* remove previous find and find second line positions */
-                xw[4] = -1;
-                for(int y2 = y1 + 1; y2 < 9; y2++)
+            /* we found an excusive cell within the block */
+            for(int xc = 0; xc < Box; xc++)
+            {
+                for(int yc = 0; yc < Box; yc++)
                 {
-                    if(s -> line_premises[X][y2][p] == 2)
+                    /* make it also a cell exclusive */
+                    if(s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
                     {
-                        xw[3] = y2;
-                        i = 4;
-                        for(int x2 = 0; x2 < 9; x2++)
+                        for(int p2 = 0; p2 < Digits; p2++)
                         {
-                            if(s -> cell_premise[x2 / 3][y2 / 3][x2 % 3][y2 % 3] & s->premise_bit[p])
-                                xw[i++] = x2;
+                            if(p2 != p)
+                            {
+                                if(clear_premise(s, xb, yb, xc, yc, p2, ReasonBlockExclusive))
+                                    rc = 1;
+                            }
                         }
                     }
                 }
-                if(xw[1] == xw[4] && xw[2] == xw[5])
-                {
-                    Trace("  found: p:%d y1:%d x:%d,%d y2:%d x:%d,%d\n", p+1, xw[0], xw[1], xw[2], xw[3], xw[4], xw[5]);
-
-                    /* clear premises in x */
-                    for(int x = 0; x < 9; x++)
-                    {
-                        /* skip the xwing ones */
-                        if(x == xw[1] || x == xw[2])
-                            continue;
-                        if(clear_premise(s, x / 3, xw[0] / 3, x % 3, xw[0] % 3, p, "deduce_xwing_y() x1"))
-                            rc = 1;
-                        if(clear_premise(s, x / 3, xw[3] / 3, x % 3, xw[3] % 3, p, "deduce_xwing_y() x2"))
-                            rc = 1;
-                    }
-
-                    /* clear premises in y */
-                    for(int y = 0; y < 9; y++)
-                    {
-                        /* skip the xwing ones */
-                        if(y == xw[0] || y == xw[3])
-                            continue;
-                        if(clear_premise(s, xw[1] / 3, y / 3, xw[1] % 3, y % 3, p, "deduce_xwing_x() y1"))
-                            rc = 1;
-                        if(clear_premise(s, xw[2] / 3, y / 3, xw[2] % 3, y % 3, p, "deduce_xwing_x() y2"))
-                            rc = 1;
-                    }
-                }
             }
         }
     }
@@ -934,486 +1734,2581 @@ int deduce_xwing_x(Sudoku *s)
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_xwing_y                                                             */
+/* deduce_block_solved_cell                                                   */
 /*----------------------------------------------------------------------------*/
-int deduce_xwing_y(Sudoku *s)
+int deduce_block_solved_cell(Sudoku *s, int xb, int yb, int xc, int yc)
 {
-    int i;
+    int p;
     int rc;
-    int xw[6];
+    const Cell *peer;
 
-    Trace("deduce_xwing_y()\n");
+    /* return if not deduced */
+    if(CellPremises(s, xb, yb, xc, yc) != 1)
+        return 0;
 
+    /* clear deduced number in other block cells */
+    p = number(s -> cell_premise[xb][yb][xc][yc]);
     rc = 0;
-    for(int p = 0; p < 9; p++)
+
+    Trace("  found c%d%d%d%d p%d\n", xb, yb, xc, yc, p + 1);
+    if(s -> steps)
+        step_found(s, s -> premise_bit[p], UnitBlock(xb, yb), 1 << (xc * Box + yc));
+
+    /* clear other cells in block, the first BlockPeers peers */
+    peer = peers[CellNumber(xb, yb, xc, yc)];
+    for(int k = 0; k < BlockPeers; k++)
+    {
+        if(clear_premise(s, peer[k].xb, peer[k].yb, peer[k].xc, peer[k].yc, p, ReasonBlockSolved))
+            rc = 1;
+    }
+
+    return rc;
+}
+
+/*----------------------------------------------------------------------------*/
+/* deduce_xline_block_group_block                                             */
+/*----------------------------------------------------------------------------*/
+int deduce_xline_block_group_block(Sudoku *s, int xb, int yb)
+{
+    int l;
+    int rc;
+    int yc;
+    const Cell *line;
+
+    rc = 0;
+
+    /* find unique premises within the block x line  */
+    for(int p = 0; p < Digits; p++)
     {
-        for(int x1 = 0; x1 < 9; x1++)
+        /* block places of x line yc are bits yc, Box + yc and so on */
+        l = -1;
+        for(yc = 0; yc < Box; yc++)
         {
-            if(s -> line_premises[Y][x1][p] == 2)
+            if(s -> block_places[xb][yb][p] & BlockXLine(yc))
             {
-                /* find first line positions */
-                xw[0] = x1;
-                i = 1;
-                for(int y1 = 0; y1 < 9; y1++)
+                if(l == -1)
+                    l = yc;
+                else
                 {
-                    if(s -> cell_premise[x1 / 3][y1 / 3][x1 % 3][y1 % 3] & s->premise_bit[p])
-                        xw[i++] = y1;
+                    l = -2;
+                    break;
                 }
+            }
+        }
+        if(l < 0)
+            continue;
 
-                /* remove previous find and find second line positions */
-                xw[4] = -1;
-                for(int x2 = x1 + 1; x2 < 9; x2++)
-                {
-                    if(s -> line_premises[Y][x2][p] == 2)
-                    {
-                        xw[3] = x2;
-                        i = 4;
-                        for(int y2 = 0; y2 < 9; y2++)
-                        {
-                            if(s -> cell_premise[x2 / 3][y2 / 3][x2 % 3][y2 % 3] & s->premise_bit[p])
-                                xw[i++] = y2;
-                        }
-                    }
-                }
-                if(xw[1] == xw[4] && xw[2] == xw[5])
-                {
-                    Trace("  found: p:%d x1:%d y:%d,%d x2:%d y:%d,%d\n", p+1, xw[0], xw[1], xw[2], xw[3], xw[4], xw[5]);
+        Trace("  found b%d%d p%d y%d\n", xb, yb, p + 1, l);
+        if(s -> steps)
+            step_found(s, s -> premise_bit[p], UnitBlock(xb, yb), s -> block_places[xb][yb][p]);
 
-                    /* clear premises in x */
-                    for(int x = 0; x < 9; x++)
-                    {
-                        /* skip the xwing ones */
-                        if(x == xw[0] || x == xw[3])
-                            continue;
-                        if(clear_premise(s, x / 3, xw[1] / 3, x % 3, xw[1] % 3, p, "deduce_xwing_y() x1"))
-                            rc = 1;
-                        if(clear_premise(s, x / 3, xw[2] / 3, x % 3, xw[2] % 3, p, "deduce_xwing_y() x2"))
-                            rc = 1;
-                    }
+        /* found double clear these in other cells */
+        line = houses[UnitXLine(yb * Box + l)];
+        for(int i = 0; i < Digits; i++)
+        {
+            if(line[i].xb == xb)
+                continue;
+            
+            if(clear_premise(s, line[i].xb, line[i].yb, line[i].xc, line[i].yc, p, ReasonXLineBlockGroup))
+                rc = 1;
+        }
+    }
 
-                    /* clear premises in y */
-                    for(int y = 0; y < 9; y++)
-                    {
-                        /* skip the xwing ones */
-                        if(y == xw[1] || y == xw[2])
-                            continue;
-                        if(clear_premise(s, xw[0] / 3, y / 3, xw[0] % 3, y % 3, p, "deduce_xwing_x() y1"))
-                            rc = 1;
-                        if(clear_premise(s, xw[3] / 3, y / 3, xw[3] % 3, y % 3, p, "deduce_xwing_x() y2"))
-                            rc = 1;
-                    }
+    return rc;
+}
+
+/*----------------------------------------------------------------------------*/
+/* deduce_yline_block_group_block                                             */
+/*----------------------------------------------------------------------------*/
+int deduce_yline_block_group_block(Sudoku *s, int xb, int yb)
+{
+    int l;
+    int rc;
+    const Cell *line;
+
+    rc = 0;
+
+    /* find unique premises within the block y line  */
+    for(int p = 0; p < Digits; p++)
+    {
+        /* block places of y line xc are bits xc * Box up to xc * Box + Box - 1 */
+        l = -1;
+        for(int xc = 0; xc < Box; xc++)
+        {
+            if(s -> block_places[xb][yb][p] & BlockYLine(xc))
+            {
+                if(l == -1)
+                    l = xc;
+                else
+                {
+                    l = -2;
+                    break;
                 }
             }
         }
+        if(l < 0)
+            continue;
+
+        Trace("  found b%d%d p%d x%d\n", xb, yb, p + 1, l);
+        if(s -> steps)
+            step_found(s, s -> premise_bit[p], UnitBlock(xb, yb), s -> block_places[xb][yb][p]);
+
+        /* found double clear these in other cells */
+        line = houses[UnitYLine(xb * Box + l)];
+        for(int i = 0; i < Digits; i++)
+        {
+            if(line[i].yb == yb)
+                continue;
+            if(clear_premise(s, line[i].xb, line[i].yb, line[i].xc, line[i].yc, p, ReasonYLineBlockGroup))
+                rc = 1;
+        }
     }
+
     return rc;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_yline_exclusive_group_cell                                          */
+/* deduce_block_exclusive_group_block                                         */
 /*----------------------------------------------------------------------------*/
-int deduce_yline_exclusive_group_cell(Sudoku *s, int xb, int yb, int xc, int yc)
+int deduce_block_exclusive_group_block(Sudoku *s, int xb, int yb)
 {
-    int c;
-    int mask;
+    return deduce_exclusive_groups(s, UnitBlock(xb, yb), ReasonBlockExclusiveGroup);
+}
+
+/*----------------------------------------------------------------------------*/
+/* deduce_block_group_block                                                   */
+/*----------------------------------------------------------------------------*/
+int deduce_block_group_block(Sudoku *s, int xb, int yb)
+{
+    return deduce_groups(s, UnitBlock(xb, yb), ReasonBlockGroup);
+}
+
+/*----------------------------------------------------------------------------*/
+/* deduce_xline_exclusive_group_line                                          */
+/*----------------------------------------------------------------------------*/
+int deduce_xline_exclusive_group_line(Sudoku *s, int y)
+{
+    return deduce_exclusive_groups(s, UnitXLine(y), ReasonXLineExclusiveGroup);
+}
+
+/*----------------------------------------------------------------------------*/
+/* deduce_xline_group_line                                                    */
+/*----------------------------------------------------------------------------*/
+int deduce_xline_group_line(Sudoku *s, int y)
+{
+    return deduce_groups(s, UnitXLine(y), ReasonXLineGroup);
+}
+
+/*----------------------------------------------------------------------------*/
+/* deduce_fish                                                                */
+/*----------------------------------------------------------------------------*/
+int deduce_fish(Sudoku *s, int l, int size)
+{
+    int combination;
+    int cover;
+    int lines;
+    int n;
+    int next;
     int rc;
+    int unit;
+    int base[Digits];
+    int places[Digits];
+    const Cell *line;
 
-    /* skip solved cells */
-    if(s -> cell_premises[xb][yb][xc][yc] == 1)
-        return 0;
+    s -> visits += Cells;
 
-    /* find exclusive group unique premises within y line */
     rc = 0;
-
-    /* test all sizes, skip 1 and 9 */
-    for(int size = 2; size < 9; size++)
+    for(int p = 0; p < Digits; p++)
     {
-        c = 0;
-        mask = 0;
-        for(int p = 0; p < 9; p++)
+        /* base line candidates hold the premise on 2 up to size places */
+        n = 0;
+        for(int i = 0; i < Digits; i++)
+        {
+            if(LinePremises(s, l, i, p) >= 2 && LinePremises(s, l, i, p) <= size)
+            {
+                places[n] = s -> line_places[l][i][p];
+                base[n++] = i;
+            }
+        }
+
+        /* every combination of size base lines, the next one by gosper's hack */
+        for(combination = (1 << size) - 1; combination < 1 << n; combination = next)
         {
-            if(s -> line_premises[Y][xb * 3 + xc][p] == size && s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
+            next = combination + (combination & -combination);
+            next |= ((next ^ combination) >> 2) >> __builtin_ctz(combination);
+
+            /* size base lines with their places on size cover lines make a fish */
+            cover = 0;
+            for(int c = combination; c; c &= c - 1)
+                cover |= places[__builtin_ctz(c)];
+            if(__builtin_popcount(cover) != size)
+                continue;
+            lines = 0;
+            for(int c = combination; c; c &= c - 1)
+                lines |= 1 << base[__builtin_ctz(c)];
+
+            Trace("  found: p:%d %s lines %03x cover %03x\n", p + 1, l == X ? "x" : "y", lines, cover);
+            if(s -> steps)
+            {
+                for(int i = 0; i < n; i++)
+                {
+                    if(!(combination & (1 << i)))
+                        continue;
+                    unit = l == X ? UnitXLine(base[i]) : UnitYLine(base[i]);
+                    if(i == __builtin_ctz(combination))
+                        step_found(s, s -> premise_bit[p], unit, s -> line_places[l][base[i]][p]);
+                    else
+                        step_cells(s, unit, s -> line_places[l][base[i]][p]);
+                }
+            }
+
+            /* clear the premise on the cover lines outside the base lines */
+            for(int j = 0; j < Digits; j++)
             {
-                mask |= s -> premise_bit[p];
-                c++;
+                if(!(cover & (1 << j)))
+                    continue;
+                line = houses[l == X ? UnitYLine(j) : UnitXLine(j)];
+                for(int i = 0; i < Digits; i++)
+                {
+                    if(lines & (1 << i))
+                        continue;
+                    if(clear_premise(s, line[i].xb, line[i].yb, line[i].xc, line[i].yc, p, l == X ? ReasonFishX : ReasonFishY))
+                        rc = 1;
+                }
             }
         }
-        if(c != size)
+    }
+    return rc;
+}
+
+/*----------------------------------------------------------------------------*/
+/* deduce_yline_exclusive_group_line                                          */
+/*----------------------------------------------------------------------------*/
+int deduce_yline_exclusive_group_line(Sudoku *s, int x)
+{
+    return deduce_exclusive_groups(s, UnitYLine(x), ReasonYLineExclusiveGroup);
+}
+
+/*----------------------------------------------------------------------------*/
+/* deduce_yline_group_line                                                    */
+/*----------------------------------------------------------------------------*/
+int deduce_yline_group_line(Sudoku *s, int x)
+{
+    return deduce_groups(s, UnitYLine(x), ReasonYLineGroup);
+}
+
+/*----------------------------------------------------------------------------*/
+/* farm                                                                       */
+/*----------------------------------------------------------------------------*/
+int farm(FILE *file, char *data, size_t size, Options *o, Totals *t)
+{
+    int jobs;
+    long written;
+    char *line;
+    Farm f;
+    Worker *workers;
+
+    jobs = o -> jobs;
+
+    /* a window of chunk slots two deals wide, the memory bound by the jobs and not by the input, */
+    /* generating a chunk per worker, as few candidates as possible made past the last one kept */
+    memset(&f, 0, sizeof(Farm));
+    f.deal = o -> generate ? jobs : jobs * FarmDeal;
+    f.window = 2 * f.deal;
+    f.jobs = jobs;
+    f.options = o;
+    f.cursor = data;
+    f.limit = data ? data + size : NULL;
+    f.file = file;
+    f.deques = malloc(jobs * sizeof(Deque));
+    f.done = calloc(f.window, sizeof(int));
+    f.lines = malloc((size_t)f.window * FarmChunk * LineSize);
+    f.sizes = malloc(f.window * sizeof(int));
+    workers = malloc(jobs * sizeof(Worker));
+    if(f.deques == NULL || f.done == NULL || f.lines == NULL || f.sizes == NULL || workers == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    pthread_mutex_init(&f.lock, NULL);
+    pthread_cond_init(&f.cond, NULL);
+    pthread_cond_init(&f.room, NULL);
+
+    /* deal the first chunks, the workers deal the next ones as they run out */
+    for(int j = 0; j < jobs; j++)
+        pthread_mutex_init(&f.deques[j].lock, NULL);
+    farm_deal(&f, -1);
+    for(int j = 0; j < jobs; j++)
+    {
+        workers[j].farm = &f;
+        workers[j].id = j;
+        memset(&workers[j].totals, 0, sizeof(Totals));
+        if(o -> ring)
+            ring_init(&workers[j].totals.ring);
+        pthread_create(&workers[j].thread, NULL, farm_worker, &workers[j]);
+    }
+
+    /* reorder buffer, write chunks in input order as soon as they are done and free their slots, */
+    /* generating the candidates kept until enough, then end the farm */
+    written = 0;
+    pthread_mutex_lock(&f.lock);
+    for(int c = 0; ; c++)
+    {
+        while(f.done[c % f.window] != c + 1 && !(f.end && c >= f.chunks))
+            pthread_cond_wait(&f.cond, &f.lock);
+        if(c >= f.chunks)
+            break;
+        pthread_mutex_unlock(&f.lock);
+        for(int i = 0; i < f.sizes[c % f.window]; i++)
+        {
+            line = f.lines + ((size_t)(c % f.window) * FarmChunk + i) * LineSize;
+            if(o -> generate && (line[0] == '\0' || written == o -> generate))
+                continue;
+            fputs(line, stdout);
+            written++;
+        }
+        pthread_mutex_lock(&f.lock);
+        f.flushed = c + 1;
+        pthread_cond_broadcast(&f.room);
+        if(o -> generate && written == o -> generate)
+        {
+            f.end = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&f.lock);
+
+    for(int j = 0; j < jobs; j++)
+    {
+        pthread_join(workers[j].thread, NULL);
+        t -> puzzles += workers[j].totals.puzzles;
+        t -> solved += workers[j].totals.solved;
+        t -> contradicted += workers[j].totals.contradicted;
+        for(int i = 0; i < LatencyBuckets; i++)
+            t -> latency[i] += workers[j].totals.latency[i];
+        t -> cleared += workers[j].totals.cleared;
+        t -> visits += workers[j].totals.visits;
+        if(o -> ring)
+        {
+            ring_write(&workers[j].totals.ring, o -> ring, j);
+            free(workers[j].totals.ring.events);
+        }
+        free(workers[j].totals.steps.text);
+        for(int i = 0; i < Techniques; i++)
+        {
+            t -> profile.runs[i] += workers[j].totals.profile.runs[i];
+            t -> profile.visits[i] += workers[j].totals.profile.visits[i];
+            t -> profile.fired[i] += workers[j].totals.profile.fired[i];
+            t -> profile.cleared[i] += workers[j].totals.profile.cleared[i];
+            t -> profile.nanoseconds[i] += workers[j].totals.profile.nanoseconds[i];
+        }
+    }
+    for(int j = 0; j < jobs; j++)
+        pthread_mutex_destroy(&f.deques[j].lock);
+    pthread_cond_destroy(&f.room);
+    pthread_cond_destroy(&f.cond);
+    pthread_mutex_destroy(&f.lock);
+    free(workers);
+    free(f.deques);
+    free(f.done);
+    free(f.lines);
+    free(f.sizes);
+    return f.n;
+}
+
+/*----------------------------------------------------------------------------*/
+/* farm_deal                                                                  */
+/*----------------------------------------------------------------------------*/
+int farm_deal(Farm *f, int id)
+{
+    int c;
+    int k;
+    int n;
+    char *lines;
+
+    /* read up to deal chunks of puzzles into their slots, called with the farm locked */
+    n = 0;
+    while(n < f -> deal && !f -> end)
+    {
+        c = f -> chunks + n;
+        lines = f -> lines + (size_t)(c % f -> window) * FarmChunk * LineSize;
+        for(k = 0; k < FarmChunk && farm_read(f, lines + (size_t)k * LineSize); k++);
+        if(k == 0)
+            break;
+        f -> sizes[c % f -> window] = k;
+        f -> n += k;
+        n++;
+    }
+
+    /* deal them in equal contiguous ranges before the workers start, later to the own deque of the */
+    /* dealer, the only one growing it, stealing balances the rest */
+    for(int j = 0; j < f -> jobs; j++)
+    {
+        if(id >= 0 && j != id)
             continue;
+        pthread_mutex_lock(&f -> deques[j].lock);
+        f -> deques[j].head = f -> chunks + (id < 0 ? (int)((long)n * j / f -> jobs) : 0);
+        f -> deques[j].tail = f -> chunks + (id < 0 ? (int)((long)n * (j + 1) / f -> jobs) : n);
+        pthread_mutex_unlock(&f -> deques[j].lock);
+    }
+    f -> chunks += n;
+
+    /* wake the workers waiting for chunks and, at the end, the reorder buffer */
+    pthread_cond_broadcast(&f -> room);
+    if(f -> end)
+        pthread_cond_signal(&f -> cond);
+    return n;
+}
+
+/*----------------------------------------------------------------------------*/
+/* farm_read                                                                  */
+/*----------------------------------------------------------------------------*/
+int farm_read(Farm *f, char *line)
+{
+    int c;
+    size_t n;
+    char *next;
+
+    /* generating, the worker makes the candidate of the line, until the reorder buffer ends the farm */
+    if(f -> options -> generate)
+        return !f -> end;
+
+    /* the next valid puzzle into line, from the mapped input or the file, 0 at the end */
+    for(;;)
+    {
+        if(f -> file)
+        {
+            if(!fgets(line, LineSize, f -> file))
+                break;
 
-        /* does the group exist */
-        c= 0;
-        for(int y = yb * 3 + yc; y < 9; y++)
+            /* drop the rest of a line longer than the buffer, one line as the mapped input reads it */
+            if(!strchr(line, '\n'))
+                while((c = getc(f -> file)) != EOF && c != '\n');
+        }
+        else
         {
-            if((s -> cell_premise[xb][y / 3][xc][y % 3] & mask) == mask)
-                c++;
+            if(f -> cursor >= f -> limit)
+                break;
+            next = memchr(f -> cursor, '\n', f -> limit - f -> cursor);
+            next = next ? next + 1 : f -> limit;
+            n = next - f -> cursor < LineSize ? (size_t)(next - f -> cursor) : LineSize - 1;
+            memcpy(line, f -> cursor, n);
+            line[n] = '\0';
+            f -> cursor = next;
         }
-        if(c != size)
+        f -> line++;
+
+        /* skip empty and comment lines */
+        if(line[0] == '\n' || line[0] == '\r' || line[0] == '#')
+            continue;
+        if(!parse(line))
+        {
+            fprintf(stderr, "Invalid puzzle at line %d\n", f -> line);
             continue;
+        }
+        return 1;
+    }
+    f -> end = 1;
+    return 0;
+}
 
-        #ifdef __TRACE__
+/*----------------------------------------------------------------------------*/
+/* farm_take                                                                  */
+/*----------------------------------------------------------------------------*/
+int farm_take(Farm *f, int id)
+{
+    int c;
+    int head;
+    int tail;
+    Deque *d;
+
+    for(;;)
+    {
+        /* take the next chunk from the own deque */
+        c = -1;
+        d = &f -> deques[id];
+        pthread_mutex_lock(&d -> lock);
+        if(d -> head < d -> tail)
+            c = d -> head++;
+        pthread_mutex_unlock(&d -> lock);
+
+        /* own deque empty, steal the back half of another deque */
+        for(int i = 1; i < f -> jobs && c < 0; i++)
         {
-            int first;
-        
-            first = 1;
-            printf("  found c%d%d%d%d ", xb, yb, xc, yc);
-            for(int p = 0; p < 9; p++)
+            d = &f -> deques[(id + i) % f -> jobs];
+            pthread_mutex_lock(&d -> lock);
+            if(d -> head < d -> tail)
             {
-                if(mask & s -> premise_bit[p])
-                {
-                    if(first)
-                    {
-                        printf("p%d", p + 1);
-                        first = 0;
-                    }
-                    else printf("-p%d", p + 1);
-                }
+                tail = d -> tail;
+                head = d -> tail - (d -> tail - d -> head + 1) / 2;
+                d -> tail = head;
+                pthread_mutex_unlock(&d -> lock);
+
+                d = &f -> deques[id];
+                pthread_mutex_lock(&d -> lock);
+                d -> head = head + 1;
+                d -> tail = tail;
+                c = head;
             }
-            printf("\n");
+            pthread_mutex_unlock(&d -> lock);
         }
-        #endif
 
-        for(int y = 0; y < 9; y++)
+        /* count the chunk taken, or with every dealt chunk taken deal the next ones once their slots */
+        /* are flushed, a steal in flight is not taken yet so look again, at the end stop */
+        pthread_mutex_lock(&f -> lock);
+        if(f -> end && f -> options -> generate)
         {
-            /* skip solved ones */
-            if(s -> cell_premises[xb][y / 3][xc][y % 3] == 1)
-                continue;
+            /* generated enough, the chunks left are dropped */
+            pthread_mutex_unlock(&f -> lock);
+            return -1;
+        }
+        if(c >= 0)
+            f -> taken++;
+        else if(f -> taken == f -> chunks)
+        {
+            while(f -> taken == f -> chunks && !f -> end && f -> chunks + f -> deal > f -> flushed + f -> window)
+                pthread_cond_wait(&f -> room, &f -> lock);
+            if(f -> taken == f -> chunks && f -> end)
+            {
+                pthread_mutex_unlock(&f -> lock);
+                return -1;
+            }
+            if(f -> taken == f -> chunks)
+                farm_deal(f, id);
+        }
+        pthread_mutex_unlock(&f -> lock);
+        if(c >= 0)
+            return c;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* farm_worker                                                                */
+/*----------------------------------------------------------------------------*/
+void *farm_worker(void *arg)
+{
+    int c;
+    char *lines;
+    Farm *f;
+    Sudoku s;
+    Worker *w;
+
+    w = arg;
+    f = w -> farm;
+
+    /* solve chunks in place, or make their candidates, with an own sudoku until the input ends and */
+    /* no work can be stolen */
+    while((c = farm_take(f, w -> id)) >= 0)
+    {
+        lines = f -> lines + (size_t)(c % f -> window) * FarmChunk * LineSize;
+        for(int i = 0; i < f -> sizes[c % f -> window]; i++)
+        {
+            if(!f -> options -> generate)
+                solve(&s, lines + (size_t)i * LineSize, lines + (size_t)i * LineSize, f -> options, &w -> totals);
+            else if(!generate_puzzle(&s, &w -> totals.arena, (long)c * FarmChunk + i, lines + (size_t)i * LineSize, f -> options, &w -> totals))
+                lines[(size_t)i * LineSize] = '\0';
+        }
+
+        pthread_mutex_lock(&f -> lock);
+        f -> done[c % f -> window] = c + 1;
+        pthread_cond_signal(&f -> cond);
+        pthread_mutex_unlock(&f -> lock);
+    }
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+/* dlx                                                                        */
+/*----------------------------------------------------------------------------*/
+int dlx(Sudoku *s, Dlx *d, int limit)
+{
+    int cell;
+    int columns[4];
+    int first;
+    int n;
+    int p;
+    int x;
+    int y;
+
+    Trace("dlx()\n");
 
-            /* clear premises */
-            for(int p = 0; p < 9; p++)
+    /* column headers in a circular list around the root */
+    for(int c = 0; c <= DlxColumns; c++)
+    {
+        d -> left[c] = c == 0 ? DlxColumns : c - 1;
+        d -> right[c] = c == DlxColumns ? 0 : c + 1;
+        d -> up[c] = d -> down[c] = d -> column[c] = c;
+        d -> size[c] = 0;
+    }
+    d -> nodes = DlxColumns + 1;
+
+    /* one row for every premise left in the sudoku */
+    for(y = 0; y < Digits; y++)
+    {
+        for(x = 0; x < Digits; x++)
+        {
+            for(p = 0; p < Digits; p++)
             {
-                if((s -> cell_premise[xb][y / 3][xc][y % 3] & mask) == mask)
-                {
-                    /* clear non group premises within group members */
-                    if(!(mask & s -> premise_bit[p]))
-                    {
-                        if(clear_premise(s, xb, y / 3, xc, y % 3, p, "deduce_yline_exclusive_group_cell() group member"))
-                            rc = 1;
-                    }                        
-                }
-                else
+                if(!(s -> cell_premise[x / Box][y / Box][x % Box][y % Box] & s -> premise_bit[p]))
+                    continue;
+
+                columns[0] = 1 + y * Digits + x;
+                columns[1] = 1 + Cells + y * Digits + p;
+                columns[2] = 1 + 2 * Cells + x * Digits + p;
+                columns[3] = 1 + 3 * Cells + ((y / Box) * Box + x / Box) * Digits + p;
+
+                first = d -> nodes;
+                for(int i = 0; i < 4; i++)
                 {
-                    /* clear group premises within non group members */
-                    if(mask & s -> premise_bit[p])
-                    {
-                        if(clear_premise(s, xb, y / 3, xc, y % 3, p, "deduce_yline_exclusive_group_cell() non group member"))
-                            rc = 1;
-                    }
+                    n = d -> nodes++;
+                    d -> column[n] = columns[i];
+                    d -> row[n] = (y * Digits + x) * Digits + p;
+                    d -> left[n] = i == 0 ? first + 3 : n - 1;
+                    d -> right[n] = i == 3 ? first : n + 1;
+                    d -> up[n] = d -> up[columns[i]];
+                    d -> down[n] = columns[i];
+                    d -> down[d -> up[columns[i]]] = n;
+                    d -> up[columns[i]] = n;
+                    d -> size[columns[i]]++;
                 }
             }
         }
     }
-    return rc;
+
+    d -> found = 0;
+    dlx_search(d, 0, limit);
+    if(!d -> found)
+    {
+        /* no exact cover, the puzzle has no solution */
+        s -> contradiction = s -> cleared;
+        return 0;
+    }
+
+    /* clear all premises not in the first exact cover */
+    for(int i = 0; i < Cells; i++)
+    {
+        cell = d -> first[i] / Digits;
+        x = cell % Digits;
+        y = cell / Digits;
+        for(p = 0; p < Digits; p++)
+        {
+            if(p != d -> first[i] % Digits)
+                clear_premise(s, x / Box, y / Box, x % Box, y % Box, p, ReasonDlx);
+        }
+    }
+    return d -> found;
+}
+
+/*----------------------------------------------------------------------------*/
+/* dlx_cover                                                                  */
+/*----------------------------------------------------------------------------*/
+int dlx_cover(Dlx *d, int c)
+{
+    /* unlink the column and every row in it from the other columns */
+    d -> right[d -> left[c]] = d -> right[c];
+    d -> left[d -> right[c]] = d -> left[c];
+    for(int i = d -> down[c]; i != c; i = d -> down[i])
+    {
+        for(int j = d -> right[i]; j != i; j = d -> right[j])
+        {
+            d -> down[d -> up[j]] = d -> down[j];
+            d -> up[d -> down[j]] = d -> up[j];
+            d -> size[d -> column[j]]--;
+        }
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* dlx_search                                                                 */
+/*----------------------------------------------------------------------------*/
+int dlx_search(Dlx *d, int k, int limit)
+{
+    int c;
+
+    /* all columns covered, exact cover found, keep the first */
+    if(d -> right[0] == 0)
+    {
+        if(d -> found++ == 0)
+            memcpy(d -> first, d -> solution, sizeof(d -> first));
+        return d -> found >= limit;
+    }
+
+    /* choose the column with the fewest rows */
+    c = d -> right[0];
+    for(int j = d -> right[c]; j != 0; j = d -> right[j])
+    {
+        if(d -> size[j] < d -> size[c])
+            c = j;
+    }
+    if(d -> size[c] == 0)
+        return 0;
+
+    dlx_cover(d, c);
+    for(int r = d -> down[c]; r != c; r = d -> down[r])
+    {
+        d -> solution[k] = d -> row[r];
+        for(int j = d -> right[r]; j != r; j = d -> right[j])
+            dlx_cover(d, d -> column[j]);
+
+        if(dlx_search(d, k + 1, limit))
+            return 1;
+
+        for(int j = d -> left[r]; j != r; j = d -> left[j])
+            dlx_uncover(d, d -> column[j]);
+    }
+    dlx_uncover(d, c);
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* dlx_uncover                                                                */
+/*----------------------------------------------------------------------------*/
+int dlx_uncover(Dlx *d, int c)
+{
+    /* relink in exact reverse order of dlx_cover() */
+    for(int i = d -> up[c]; i != c; i = d -> up[i])
+    {
+        for(int j = d -> left[i]; j != i; j = d -> left[j])
+        {
+            d -> size[d -> column[j]]++;
+            d -> down[d -> up[j]] = j;
+            d -> up[d -> down[j]] = j;
+        }
+    }
+    d -> right[d -> left[c]] = c;
+    d -> left[d -> right[c]] = c;
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* fill                                                                       */
+/*----------------------------------------------------------------------------*/
+int fill(Sudoku *s, const char *puzzle)
+{
+    int n;
+    int rc;
+    const Cell *cell;
+
+    Trace("fill()\n");
+    rc = 0;
+    for(int x = 0; x < Digits; x++)
+    {
+        for(int y = 0; y < Digits; y++)
+        {
+            /* a number symbol is a given, anything else an empty cell */
+            n = SymbolNumber(puzzle[y * Digits + x]);
+            if(n >= 0 && n < Digits)
+            {
+                cell = &houses[UnitXLine(y)][x];
+                Trace("  found c%d%d%d%d p%d\n", cell -> xb, cell -> yb, cell -> xc, cell -> yc, n + 1);
+                for(int p = 0; p < Digits; p++)
+                {
+                    /* clear all other premises within cell */
+                    if(p != n)
+                    {
+                        if(clear_premise(s, cell -> xb, cell -> yb, cell -> xc, cell -> yc, p, ReasonFill))
+                            rc = 1;
+                    }
+                }
+            }
+        }
+    }
+    return rc;
+}
+
+/*----------------------------------------------------------------------------*/
+/* generate                                                                   */
+/*----------------------------------------------------------------------------*/
+int generate(Options *o, Totals *t)
+{
+    char line[LineSize];
+    Sudoku s;
+
+    /* the candidates in order until enough reach the target, -j generates them with the farm */
+    for(long k = 0, n = 0; n < o -> generate; k++)
+    {
+        if(generate_puzzle(&s, &t -> arena, k, line, o, t))
+        {
+            fputs(line, stdout);
+            n++;
+        }
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* generate_grid                                                              */
+/*----------------------------------------------------------------------------*/
+int generate_grid(Sudoku *s, Arena *a, char *puzzle, unsigned long *seed)
+{
+    int j;
+    char digits[Digits];
+    const Cell *cell;
+
+    /* random numbers in the blocks on the diagonal, they share no unit */
+    do
+    {
+        memset(puzzle, '.', Cells);
+        for(int b = 0; b < Box; b++)
+        {
+            for(int i = 0; i < Digits; i++)
+                digits[i] = Symbol(i);
+            for(int i = Digits - 1; i > 0; i--)
+            {
+                j = generate_random(seed) % (i + 1);
+                cell = &houses[UnitBlock(b, b)][i];
+                puzzle[(cell -> yb * Box + cell -> yc) * Digits + cell -> xb * Box + cell -> xc] = digits[j];
+                digits[j] = digits[i];
+            }
+            cell = houses[UnitBlock(b, b)];
+            puzzle[(cell -> yb * Box + cell -> yc) * Digits + cell -> xb * Box + cell -> xc] = digits[0];
+        }
+
+        /* the search completes the grid, on a 4x4 board not every diagonal can be completed */
+        init(s);
+        s -> pipeline = &pipeline_singles;
+        fill(s, puzzle);
+    }
+    while(!search(s, a, 1));
+    return solution(s, puzzle);
+}
+
+/*----------------------------------------------------------------------------*/
+/* generate_puzzle                                                            */
+/*----------------------------------------------------------------------------*/
+int generate_puzzle(Sudoku *s, Arena *a, long k, char *line, Options *o, Totals *t)
+{
+    char puzzle[Cells];
+    unsigned long seed;
+    Options grade;
+
+    /* candidate k from its own seed, splitmix64 of the seed and k, the same puzzles for any -j */
+    seed = o -> seed + (unsigned long)(k + 1) * 0x9e3779b97f4a7c15UL;
+    seed = (seed ^ seed >> 30) * 0xbf58476d1ce4e5b9UL;
+    seed = (seed ^ seed >> 27) * 0x94d049bb133111ebUL;
+    seed = (seed ^ seed >> 31) | 1;
+
+    /* a random grid, then the givens that keep it unique */
+    generate_grid(s, a, puzzle, &seed);
+    generate_remove(s, a, puzzle, &seed);
+
+    /* grade it as -g does, with the pipeline of the options, kept when its hardest technique is in range */
+    grade = *o;
+    grade.count = 0;
+    grade.engine = EngineDeduce;
+    grade.grade = 1;
+    if(!(solve(s, puzzle, line, &grade, t) ? s -> hardest >= o -> easiest && s -> hardest <= o -> hardest : o -> hardest == Techniques))
+        return 0;
+    memcpy(line, puzzle, Cells);
+    return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/* generate_random                                                            */
+/*----------------------------------------------------------------------------*/
+unsigned long generate_random(unsigned long *seed)
+{
+    /* xorshift64*, the seed is never 0 */
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    return (*seed * 0x2545f4914f6cdd1dUL) >> 32;
+}
+
+/*----------------------------------------------------------------------------*/
+/* generate_remove                                                            */
+/*----------------------------------------------------------------------------*/
+int generate_remove(Sudoku *s, Arena *a, char *puzzle, unsigned long *seed)
+{
+    char given;
+    int i;
+    int j;
+    int givens;
+    int mask;
+    int n;
+    unsigned short order[Cells];
+    const Cell *cell;
+    const Cell *peer;
+
+    /* the cells in random order */
+    for(i = 0; i < Cells; i++)
+        order[i] = i;
+    for(i = Cells - 1; i > 0; i--)
+    {
+        j = generate_random(seed) % (i + 1);
+        n = order[i];
+        order[i] = order[j];
+        order[j] = n;
+    }
+
+    /* remove a given when no solution has another number there, the puzzle stays unique */
+    givens = Cells;
+    for(i = 0; i < Cells; i++)
+    {
+        given = puzzle[order[i]];
+        puzzle[order[i]] = '.';
+        cell = &houses[UnitXLine(order[i] / Digits)][order[i] % Digits];
+
+        /* the givens of the peers leaving one number keep it, no search needed */
+        mask = 0;
+        peer = peers[CellNumber(cell -> xb, cell -> yb, cell -> xc, cell -> yc)];
+        for(int k = 0; k < Peers; k++)
+        {
+            j = puzzle[(peer[k].yb * Box + peer[k].yc) * Digits + peer[k].xb * Box + peer[k].xc];
+            if(j != '.')
+                mask |= 1 << SymbolNumber(j);
+        }
+        if(__builtin_popcount(mask) == Digits - 1)
+        {
+            givens--;
+            continue;
+        }
+
+        init(s);
+        s -> pipeline = &pipeline_singles;
+        fill(s, puzzle);
+        clear_premise(s, cell -> xb, cell -> yb, cell -> xc, cell -> yc, SymbolNumber(given), ReasonSearch);
+        if(search(s, a, 1))
+            puzzle[order[i]] = given;
+        else
+            givens--;
+    }
+    return givens;
+}
+
+/*----------------------------------------------------------------------------*/
+/* init                                                                       */
+/*----------------------------------------------------------------------------*/
+int init(Sudoku *s)
+{
+    Trace("init()\n");
+
+    /* init cleared, eliminations, visits and profile */
+    s -> cleared = 0;
+    s -> eliminations = 0;
+    s -> visits = 0;
+    s -> pipeline = &pipeline_full;
+    s -> profile = NULL;
+    s -> ring = NULL;
+    s -> steps = NULL;
+    s -> trail = NULL;
+    s -> rounds = 0;
+    s -> waves = 0;
+    s -> hardest = -1;
+    s -> score = 0;
+    s -> queue_head = 0;
+    s -> queue_tail = 0;
+    s -> contradiction = 0;
+
+    /* init changed and seen, all units need a first run */
+    for(int u = 0; u < Units; u++)
+    {
+        s -> changed[u] = 0;
+        for(int t = 0; t < Techniques; t++)
+            s -> seen[t][u] = -1;
+    }
+
+    /* init static premise premise_bits */
+    for(int p = 0; p < Digits; p++)
+        s -> premise_bit[p] = 1 << p;
+    
+    /* init block_premises and block_places */
+    for(int xb = 0; xb < Box; xb++)
+    {
+        for(int yb = 0; yb < Box; yb++)
+        {
+            for(int p = 0; p < Digits; p++)
+            {
+                #ifndef __POPCOUNT__
+                    s -> block_premises[xb][yb][p] = Digits;
+                #endif
+                s -> block_places[xb][yb][p] = AllPremiseBitsOn;
+            }
+        }
+    }
+
+    /* init cell_premise and cell_premises */
+    for(int xb = 0; xb < Box; xb++)
+    {
+        for(int yb = 0; yb < Box; yb++)
+        {
+            for(int xc = 0; xc < Box; xc++)
+            {
+                for(int yc = 0; yc < Box; yc++)
+                {
+                    s -> cell_premise[xb][yb][xc][yc] = AllPremiseBitsOn;
+                    #ifndef __POPCOUNT__
+                        s -> cell_premises[xb][yb][xc][yc] = Digits;
+                    #endif
+                }
+            }
+        }
+    }
+
+    /* init line_premises and line_places */
+    for(int xy = 0; xy < Digits; xy++)
+    {
+        for(int p = 0; p < Digits; p++)
+        {
+            #ifndef __POPCOUNT__
+                s -> line_premises[X][xy][p] = Digits;
+                s -> line_premises[Y][xy][p] = Digits;
+            #endif
+            s -> line_places[X][xy][p] = AllPremiseBitsOn;
+            s -> line_places[Y][xy][p] = AllPremiseBitsOn;
+        }
+    }
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* latency_bucket                                                             */
+/*----------------------------------------------------------------------------*/
+int latency_bucket(long nanoseconds)
+{
+    int e;
+
+    /* exact below 32 ns, above 16 buckets per power of 2, within 6% */
+    if(nanoseconds < 32)
+        return nanoseconds < 0 ? 0 : nanoseconds;
+    e = 63 - __builtin_clzl(nanoseconds);
+    if(e > 40)
+        return LatencyBuckets - 1;
+    return 32 + (e - 5) * 16 + ((nanoseconds >> (e - 4)) & 15);
+}
+
+/*----------------------------------------------------------------------------*/
+/* latency_percentile                                                         */
+/*----------------------------------------------------------------------------*/
+long latency_percentile(long *latency, double fraction)
+{
+    long n;
+    long sum;
+    long total;
+
+    /* the lowest time of the bucket holding the fraction of the puzzles */
+    total = 0;
+    for(int b = 0; b < LatencyBuckets; b++)
+        total += latency[b];
+    n = (long)(fraction * total + 0.999999);
+    sum = 0;
+    for(int b = 0; b < LatencyBuckets; b++)
+    {
+        sum += latency[b];
+        if(sum >= n && sum > 0)
+            return b < 32 ? b : (long)(16 + (b - 32) % 16) << ((b - 32) / 16 + 1);
+    }
+    return 0;
+}
+
+#ifndef __LIBRARY__
+/*----------------------------------------------------------------------------*/
+/* main                                                                       */
+/*----------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int mapped;
+    double elapsed;
+    size_t size;
+    char *data;
+    char *name;
+    FILE *f;
+    Options options;
+    Sudoku s;
+    static Totals totals;
+    struct timespec start;
+    struct timespec stop;
+    char puzzle[Cells];
+
+    /* options */
+    options.bench = NULL;
+    options.count = 0;
+    options.easiest = -1;
+    options.engine = EngineDeduce;
+    options.generate = 0;
+    options.grade = 0;
+    options.hardest = Techniques - 1;
+    options.jobs = 1;
+    options.pipeline = pipeline_full;
+    options.profile = ProfileNone;
+    options.ring = NULL;
+    options.search = 0;
+    options.seed = 1;
+    options.steps = NULL;
+    options.timing = 0;
+    options.undo = UndoCopy;
+    twins_select(NULL);
+    while((c = getopt(argc, argv, "b:c:d:e:gj:k:l:m:n:p:r:stu:x:")) != -1)
+    {
+        switch(c)
+        {
+            case 'b':
+                options.bench = optarg;
+                break;
+            case 'c':
+                options.count = atoi(optarg);
+                if(options.count < 1)
+                    options.count = 2;
+                break;
+            case 'd':
+                return ring_decode(optarg);
+            case 'e':
+                if(strcmp(optarg, "dlx") == 0)
+                    options.engine = EngineDlx;
+                else if(strcmp(optarg, "deduce") == 0)
+                    options.engine = EngineDeduce;
+                else
+                {
+                    fprintf(stderr, "Unknown engine %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'g':
+                options.grade = 1;
+                break;
+            case 'j':
+                options.jobs = atoi(optarg);
+                if(options.jobs < 1)
+                    options.jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+                break;
+            case 'k':
+                if(!twins_select(optarg))
+                {
+                    fprintf(stderr, "Unsupported kernel %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'l':
+                options.steps = fopen(optarg, "w");
+                if(options.steps == NULL)
+                {
+                    fprintf(stderr, "Cannot open %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'm':
+                /* at least the first technique, up to the second or the last one, unsolved only when named */
+                name = strchr(optarg, ':');
+                options.easiest = technique(optarg, name ? name - optarg : (int)strlen(optarg));
+                options.hardest = name ? technique(name + 1, strlen(name + 1)) : options.easiest == Techniques ? Techniques : Techniques - 1;
+                if(options.easiest < 0 || options.hardest < options.easiest)
+                {
+                    fprintf(stderr, "Unknown technique range %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'n':
+                options.generate = atol(optarg);
+                if(strchr(optarg, ':'))
+                    options.seed = strtoul(strchr(optarg, ':') + 1, NULL, 10);
+                if(options.generate < 1)
+                    options.generate = 1;
+                break;
+            case 'p':
+                if(strcmp(optarg, "table") == 0)
+                    options.profile = ProfileTable;
+                else if(strcmp(optarg, "json") == 0)
+                    options.profile = ProfileJson;
+                else
+                {
+                    fprintf(stderr, "Unknown profile format %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'r':
+                options.ring = fopen(optarg, "wb");
+                if(options.ring == NULL)
+                {
+                    fprintf(stderr, "Cannot open %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 's':
+                options.search = 1;
+                break;
+            case 't':
+                options.timing = 1;
+                break;
+            case 'u':
+                if(strcmp(optarg, "trail") == 0)
+                    options.undo = UndoTrail;
+                else if(strcmp(optarg, "copy") == 0)
+                    options.undo = UndoCopy;
+                else
+                {
+                    fprintf(stderr, "Unknown undo %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'x':
+                if(!pipeline(&options.pipeline, optarg))
+                {
+                    fprintf(stderr, "Invalid pipeline %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-b corpus] [-c count] [-e deduce|dlx] [-g] [-j jobs] [-k scalar|sse2|avx2] [-l steps] [-m technique|unsolved[:technique|unsolved]] [-n count[:seed]] [-p table|json] [-r ring] [-s] [-t] [-u copy|trail] [-x full|singles|technique,...[:restart|:continue]] [file|-]\n       %s -d ring\n", argv[0], argv[0]);
+                return 1;
+        }
+    }
+
+    /* batch mode, puzzles from stdin or file or generated */
+    if(optind < argc || options.generate)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+
+        /* map a file, read stdin or pipes as a stream */
+        mapped = 0;
+        data = NULL;
+        f = stdin;
+        if(!options.generate && strcmp(argv[optind], "-") != 0)
+        {
+            data = map(argv[optind], &size);
+            mapped = data != NULL;
+            if(!mapped && (f = fopen(argv[optind], "r")) == NULL)
+            {
+                fprintf(stderr, "Cannot open %s\n", argv[optind]);
+                return 1;
+            }
+        }
+
+        memset(&totals, 0, sizeof(Totals));
+        if(options.ring && options.jobs == 1)
+            ring_init(&totals.ring);
+        if(options.generate && options.jobs == 1)
+            generate(&options, &totals);
+        else if(options.jobs > 1)
+            farm(mapped ? NULL : f, data, size, &options, &totals);
+        else if(mapped)
+            batch_map(data, size, &options, &totals);
+        else
+            batch(f, &options, &totals);
+
+        if(mapped)
+            munmap(data, size);
+        if(f != stdin)
+            fclose(f);
+
+        fflush(stdout);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        elapsed = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+        if(options.timing)
+        {
+            fprintf(stderr, "%ld puzzles (%ld solved, %ld contradicted) in %.3f s, %.0f puzzles/second, %.0f eliminations/second, %.0f cell visits/puzzle\n",
+                totals.puzzles, totals.solved, totals.contradicted, elapsed, totals.puzzles / elapsed, totals.cleared / elapsed, (double)totals.visits / totals.puzzles);
+        }
+        if(options.bench)
+            print_bench(&totals, &options, elapsed);
+        if(options.profile)
+            print_profile(&totals.profile, options.profile);
+        if(options.ring)
+        {
+            if(options.jobs == 1)
+            {
+                ring_write(&totals.ring, options.ring, 0);
+                free(totals.ring.events);
+            }
+            fclose(options.ring);
+        }
+        if(options.steps)
+        {
+            free(totals.steps.text);
+            fclose(options.steps);
+        }
+        return 0;
+    }
+
+    /* Initialize, print and fill */
+    sample(puzzle);
+    init(&s);
+    print(&s);
+    fill(&s, puzzle);
+
+    /* print and deduce until deduced */
+    do
+    {
+        print(&s);
+    }
+    while (deduce(&s));
+
+    return 0;
+}
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* map                                                                        */
+/*----------------------------------------------------------------------------*/
+char *map(char *filename, size_t *size)
+{
+    int fd;
+    char *data;
+    struct stat st;
+
+    /* map a regular file, pipes and empty files are read as a stream */
+    fd = open(filename, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+    if(fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return NULL;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    *size = st.st_size;
+    return data;
+}
+
+/*----------------------------------------------------------------------------*/
+/* number                                                                     */
+/*----------------------------------------------------------------------------*/
+int number(int p)
+{
+    /* return the bit position number of the lowest bit */
+    if(p == 0)
+        return -1;
+    return __builtin_ctz(p);
+}
+
+/*----------------------------------------------------------------------------*/
+/* parse                                                                      */
+/*----------------------------------------------------------------------------*/
+int parse(const char *line)
+{
+    /* accept Cells cells of number symbols and '0' or '.' for empty cells */
+    for(int i = 0; i < Cells; i++)
+    {
+        if(line[i] != '.' && line[i] != '0' && (SymbolNumber(line[i]) < 0 || SymbolNumber(line[i]) >= Digits))
+            return 0;
+    }
+    return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/* pipeline                                                                   */
+/*----------------------------------------------------------------------------*/
+int pipeline(Pipeline *pl, const char *spec)
+{
+    const char *name;
+    const char *policy;
+    const char *next;
+    int n;
+    int t;
+
+    /* a profile or a comma separated list of techniques, with or without deduce_ */
+    policy = strchr(spec, ':');
+    n = policy ? policy - spec : (int)strlen(spec);
+    if(n == 4 && strncmp(spec, "full", 4) == 0)
+        *pl = pipeline_full;
+    else if(n == 7 && strncmp(spec, "singles", 7) == 0)
+        *pl = pipeline_singles;
+    else
+    {
+        pl -> techniques = 0;
+        pl -> restart = 1;
+        for(name = spec; name < spec + n; name = next + 1)
+        {
+            next = memchr(name, ',', spec + n - name);
+            if(next == NULL)
+                next = spec + n;
+            t = technique(name, next - name);
+            if(t < 0 || t == Techniques || pl -> techniques == Techniques)
+                return 0;
+            pl -> order[pl -> techniques++] = t;
+        }
+    }
+
+    /* the restart policy overrides the one of the profile */
+    if(policy && strcmp(policy, ":restart") == 0)
+        pl -> restart = 1;
+    else if(policy && strcmp(policy, ":continue") == 0)
+        pl -> restart = 0;
+    else if(policy)
+        return 0;
+    return pl -> techniques > 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* print                                                                      */
+/*----------------------------------------------------------------------------*/
+int print(Sudoku *s)
+{
+    const Cell *cell;
+
+    Trace("print()\n");
+    printf("\n");
+
+    /* print sudoku */
+    #ifdef __TRACE__
+        /* print line statistics */
+        for(int p = 0; p < Digits; p++)
+        {
+            printf("          ");
+            for(int x = 0; x < Digits; x++)
+            {
+                if(x && x % Box == 0)
+                    printf("  ");
+                printf(" %d", LinePremises(s, Y, x, p));
+            }
+            printf("\n");
+        }
+        printf("         ");
+    #endif
+    printf(" ");
+    for(int i = 0; i < 2 * (Digits + Box) - 1; i++)
+        printf("-");
+    printf("\n");
+    for(int y = 0; y < Digits; y++)
+    {
+        if(y && y % Box == 0)
+        {
+            #ifdef __TRACE__
+                printf("         ");
+            #endif
+            printf("|%*s|\n", 2 * (Digits + Box) - 1, "");
+        }
+        #ifdef __TRACE__
+            for(int p = 0; p < Digits; p++)
+            {
+                printf("%d", LinePremises(s, X, y, p));
+            }
+        #endif
+        for(int x = 0; x < Digits; x++)
+        {
+            if(x && x % Box == 0)
+                printf("  ");
+            if(x == 0)
+                printf("|");
+            cell = &houses[UnitXLine(y)][x];
+            if(CellPremises(s, cell -> xb, cell -> yb, cell -> xc, cell -> yc) == 1)
+                printf(" %c", Symbol(number(s -> cell_premise[cell -> xb][cell -> yb][cell -> xc][cell -> yc])));
+            else
+                printf(" .");
+            if(x == Digits - 1)
+                printf(" |");
+        }
+        printf("\n");
+    }
+    #ifdef __TRACE__
+        printf("         ");
+    #endif
+    printf(" ");
+    for(int i = 0; i < 2 * (Digits + Box) - 1; i++)
+        printf("-");
+    printf("\n");
+
+    /* print cell statistics */
+    #ifdef __TRACE__
+        all_cells(s, print_cell);
+        printf("\n");
+    #endif
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* print_bench                                                                */
+/*----------------------------------------------------------------------------*/
+int print_bench(Totals *t, Options *o, double elapsed)
+{
+    /* one json line on stderr, to diff across commits */
+    fprintf(stderr, "{\"corpus\":\"%s\",\"undo\":\"%s\",\"puzzles\":%ld,\"solved\":%ld,\"contradicted\":%ld,\"seconds\":%.6f,"
+        "\"puzzles_per_second\":%.0f,\"eliminations_per_second\":%.0f,\"visits_per_puzzle\":%.0f,"
+        "\"latency_median_ns\":%ld,\"latency_p99_ns\":%ld}\n",
+        o -> bench, o -> undo == UndoTrail ? "trail" : "copy", t -> puzzles, t -> solved, t -> contradicted, elapsed, t -> puzzles / elapsed, t -> cleared / elapsed,
+        t -> puzzles ? (double)t -> visits / t -> puzzles : 0.0, latency_percentile(t -> latency, 0.5), latency_percentile(t -> latency, 0.99));
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* print_cell                                                                 */
+/*----------------------------------------------------------------------------*/
+int print_cell(Sudoku *s, int xb, int yb, int xc, int yc)
+{
+    /* print block premises */
+    if(xc == 0 && yc == 0)
+    {
+        printf("\n      ");
+        for(int p = 0; p < Digits; p++)
+        {
+            if(BlockPremises(s, xb, yb, p))
+                printf("%d", BlockPremises(s, xb, yb, p));
+            else
+                printf(".");
+        }
+        printf("\n");
+    }    
+
+    /* print cell premises */
+    printf("%d%d%d%d: ", xb, yb, xc, yc);
+    for(int p = 0; p < Digits; p++)
+    {
+        if(s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
+            printf("%c", Symbol(p));
+        else
+            printf(".");
+    }
+
+    /* print cell premise size or sudoku value */
+    printf(" %d\n", CellPremises(s, xb, yb, xc, yc));
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int records(char *data, size_t size, char ***puzzles)
+{
+    int allocated;
+    int l;
+    int n;
+    char *end;
+    char *next;
+    char *p;
+
+    /* index the puzzle records in place */
+    allocated = 1024;
+    l = 0;
+    n = 0;
+    *puzzles = malloc(allocated * sizeof(char *));
+    end = data + size;
+    for(p = data; p < end; p = next)
+    {
+        next = memchr(p, '\n', end - p);
+        next = next ? next + 1 : end;
+        l++;
+
+        /* skip empty and comment lines */
+        if(*p == '\n' || *p == '\r' || *p == '#')
+            continue;
+        if(next - p < Cells || !parse(p))
+        {
+            fprintf(stderr, "Invalid puzzle at line %d\n", l);
+            continue;
+        }
+
+        if(n == allocated)
+        {
+            allocated *= 2;
+            *puzzles = realloc(*puzzles, allocated * sizeof(char *));
+        }
+        if(*puzzles == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        (*puzzles)[n++] = p;
+    }
+    return n;
+}
+
+/*----------------------------------------------------------------------------*/
+/* print_profile                                                              */
+/*----------------------------------------------------------------------------*/
+int print_profile(Profile *p, int format)
+{
+    /* print the technique counters on stderr as table or json */
+    if(format == ProfileJson)
+    {
+        fprintf(stderr, "{\"techniques\":[");
+        for(int t = 0; t < Techniques; t++)
+        {
+            fprintf(stderr, "%s{\"name\":\"%s\",\"runs\":%ld,\"visits\":%ld,\"fired\":%ld,\"cleared\":%ld,\"nanoseconds\":%ld}",
+                t ? "," : "", technique_names[t], p -> runs[t], p -> visits[t], p -> fired[t], p -> cleared[t], p -> nanoseconds[t]);
+        }
+        fprintf(stderr, "]}\n");
+        return 0;
+    }
+
+    fprintf(stderr, "%-30s %10s %12s %10s %10s %12s %8s\n", "technique", "runs", "visits", "fired", "cleared", "ns", "ns/run");
+    for(int t = 0; t < Techniques; t++)
+    {
+        fprintf(stderr, "%-30s %10ld %12ld %10ld %10ld %12ld %8.0f\n", technique_names[t], p -> runs[t], p -> visits[t],
+            p -> fired[t], p -> cleared[t], p -> nanoseconds[t], p -> runs[t] ? (double)p -> nanoseconds[t] / p -> runs[t] : 0.0);
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* ring_decode                                                                */
+/*----------------------------------------------------------------------------*/
+int ring_decode(char *filename)
+{
+    FILE *f;
+    int thread;
+    unsigned long events;
+    Event e;
+
+    if((f = fopen(filename, "rb")) == NULL)
+    {
+        fprintf(stderr, "Cannot open %s\n", filename);
+        return 1;
+    }
+
+    /* each ring is a header followed by its events, oldest first */
+    while(fread(&thread, sizeof(int), 1, f) == 1 && fread(&events, sizeof(unsigned long), 1, f) == 1)
+    {
+        printf("thread %d, %lu events\n", thread, events);
+        for(unsigned long i = 0; i < events && fread(&e, sizeof(Event), 1, f) == 1; i++)
+        {
+            if(e.reason >= Reasons || e.cell >= Cells || e.premise >= Digits)
+            {
+                fprintf(stderr, "Bad event in %s\n", filename);
+                fclose(f);
+                return 1;
+            }
+            printf("    clear (%3d/%d) c%d%d%d%d p%d %s\n", e.cleared, Premises - Cells,
+                e.cell / (Box * Digits), e.cell / Digits % Box, e.cell / Box % Box, e.cell % Box, e.premise + 1, reason_names[e.reason]);
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* ring_init                                                                  */
+/*----------------------------------------------------------------------------*/
+int ring_init(Ring *r)
+{
+    r -> events = malloc(RingEvents * sizeof(Event));
+    r -> head = 0;
+    return r -> events != NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+/* ring_write                                                                 */
+/*----------------------------------------------------------------------------*/
+int ring_write(Ring *r, FILE *f, int thread)
+{
+    unsigned long first;
+    unsigned long events;
+
+    /* the ring holds the last RingEvents events */
+    first = r -> head > RingEvents ? r -> head - RingEvents : 0;
+    events = r -> head - first;
+    fwrite(&thread, sizeof(int), 1, f);
+    fwrite(&events, sizeof(unsigned long), 1, f);
+    for(unsigned long i = first; i < r -> head; i++)
+        fwrite(&r -> events[i & (RingEvents - 1)], sizeof(Event), 1, f);
+    return events;
+}
+
+/*----------------------------------------------------------------------------*/
+/* sample                                                                     */
+/*----------------------------------------------------------------------------*/
+int sample(char *puzzle)
+{
+#if Box == 3
+    int sudoku[9][9] = S;
+
+    /* convert the compiled in sudoku to a puzzle line */
+    for(int y = 0; y < Digits; y++)
+    {
+        for(int x = 0; x < Digits; x++)
+            puzzle[y * 9 + x] = sudoku[y][x] ? '0' + sudoku[y][x] : '.';
+    }
+#else
+    /* the samples are 9x9, other sizes start from an empty board */
+    memset(puzzle, '.', Cells);
+#endif
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* search                                                                     */
+/*----------------------------------------------------------------------------*/
+int search(Sudoku *s, Arena *a, int limit)
+{
+    int found;
+    int mask;
+    int n;
+    int premises;
+    int xb;
+    int yb;
+    int xc;
+    int yc;
+    int top;
+    int tried;
+    int mark;
+    unsigned char *board;
+    Steps *steps;
+
+    /* at the top the arena starts empty */
+    top = a -> depth == 0;
+    if(top)
+        a -> solutions = 0;
+
+    /* propagate with the deductions, stop when solved or contradicted */
+    while(deduce(s));
+    switch(state(s))
+    {
+        case 1:
+            if(a -> solutions++ == 0)
+                memcpy(a -> first, s, SnapshotSize);
+            return 1;
+        case -1:
+            return 0;
+    }
+
+    /* branch on the open cell with the fewest premises */
+    premises = Digits + 1;
+    xb = yb = xc = yc = 0;
+    for(int xb2 = 0; xb2 < Box; xb2++)
+    {
+        for(int yb2 = 0; yb2 < Box; yb2++)
+        {
+            for(int xc2 = 0; xc2 < Box; xc2++)
+            {
+                for(int yc2 = 0; yc2 < Box; yc2++)
+                {
+                    n = CellPremises(s, xb2, yb2, xc2, yc2);
+                    if(n > 1 && n < premises)
+                    {
+                        xb = xb2;
+                        yb = yb2;
+                        xc = xc2;
+                        yc = yc2;
+                        premises = n;
+                    }
+                }
+            }
+        }
+    }
+
+    Trace("search() c%d%d%d%d %d premises\n", xb, yb, xc, yc, premises);
+
+    /* snapshot the board, or the part the trail does not undo and the mark, the branches record no steps */
+    board = a -> boards[a -> depth++];
+    if(s -> trail)
+    {
+        memcpy(board, s, UntrailedSize);
+        mark = s -> trail -> tail;
+    }
+    else
+    {
+        memcpy(board, s, SnapshotSize);
+        mark = -1;
+    }
+    steps = s -> steps;
+    s -> steps = NULL;
+
+    /* try every premise from the snapshot, count up to limit solutions */
+    found = tried = 0;
+    mask = s -> cell_premise[xb][yb][xc][yc];
+    for(int p = 0; p < Digits && found < limit; p++)
+    {
+        if(!(mask & s -> premise_bit[p]))
+            continue;
+
+        if(tried++)
+            search_restore(s, board, mark);
+        for(int p2 = 0; p2 < Digits; p2++)
+        {
+            if(p2 != p)
+                clear_premise(s, xb, yb, xc, yc, p2, ReasonSearch);
+        }
+        found += search(s, a, limit - found);
+    }
+    a -> depth--;
+    s -> steps = steps;
+
+    /* leave the first solution, or the board as it was when none, contradicted as no branch solves it */
+    if(top && found)
+    {
+        memcpy(s, a -> first, SnapshotSize);
+        if(s -> trail)
+            s -> trail -> tail = mark;
+    }
+    else if(top)
+    {
+        search_restore(s, board, mark);
+        s -> contradiction = s -> cleared;
+    }
+    return found;
+}
+
+/*----------------------------------------------------------------------------*/
+/* search_restore                                                             */
+/*----------------------------------------------------------------------------*/
+int search_restore(Sudoku *s, unsigned char *board, int mark)
+{
+    /* undo the clears after the mark and restore the rest, or copy the board back, every cell of it */
+    if(s -> trail)
+    {
+        undo(s, mark);
+        memcpy(s, board, UntrailedSize);
+    }
+    else
+    {
+        memcpy(s, board, SnapshotSize);
+        s -> visits += Cells;
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* solution                                                                   */
+/*----------------------------------------------------------------------------*/
+int solution(const Sudoku *s, char *puzzle)
+{
+    int rc;
+    const Cell *cell;
+
+    /* write the sudoku as puzzle line, '.' for unsolved cells */
+    rc = 1;
+    for(int y = 0; y < Digits; y++)
+    {
+        for(int x = 0; x < Digits; x++)
+        {
+            cell = &houses[UnitXLine(y)][x];
+            if(CellPremises(s, cell -> xb, cell -> yb, cell -> xc, cell -> yc) == 1)
+                puzzle[y * Digits + x] = Symbol(number(s -> cell_premise[cell -> xb][cell -> yb][cell -> xc][cell -> yc]));
+            else
+            {
+                puzzle[y * Digits + x] = '.';
+                rc = 0;
+            }
+        }
+    }
+    return rc;
+}
+
+/*----------------------------------------------------------------------------*/
+/* solve                                                                      */
+/*----------------------------------------------------------------------------*/
+int solve(Sudoku *s, char *puzzle, char *line, Options *o, Totals *t)
+{
+    int found;
+    int rc;
+    struct timespec start;
+    struct timespec stop;
+
+    /* deduce the puzzle from scratch, timed for the latency with -b */
+    if(o -> bench)
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    init(s);
+    s -> pipeline = &o -> pipeline;
+    if(o -> profile)
+        s -> profile = &t -> profile;
+    if(o -> ring && t -> ring.events)
+        s -> ring = &t -> ring;
+    if(o -> steps && step_begin(&t -> steps, puzzle))
+        s -> steps = &t -> steps;
+    if(o -> undo == UndoTrail)
+    {
+        t -> trail.tail = 0;
+        s -> trail = &t -> trail;
+    }
+    fill(s, puzzle);
+    found = 0;
+    if(o -> grade)
+        while(deduce(s));
+    else if(o -> engine == EngineDlx)
+        found = dlx(s, &t -> dlx, o -> count ? o -> count : 1);
+    else if(o -> search || o -> count)
+        found = search(s, &t -> arena, o -> count ? o -> count : 1);
+    else
+        while(deduce(s));
+
+    /* write the result line, with the grade or the number of solutions, a contradicted puzzle says so */
+    rc = solution(s, line) && !s -> contradiction;
+    if(o -> steps)
+        step_end(&t -> steps, o -> steps, line, rc);
+    if(o -> grade)
+        sprintf(line + Cells, " %s %d %d\n", s -> contradiction ? "contradiction" : !rc ? "unsolved" : s -> hardest < 0 ? "none" : technique_names[s -> hardest], s -> rounds, s -> score);
+    else if(o -> count)
+        sprintf(line + Cells, " %d %s\n", found, found == 0 ? "none" : found == 1 ? "unique" : "multiple");
+    else if(s -> contradiction)
+        strcpy(line + Cells, " contradiction\n");
+    else
+        strcpy(line + Cells, "\n");
+
+    t -> puzzles++;
+    t -> solved += rc;
+    t -> contradicted += s -> contradiction != 0;
+    t -> cleared += s -> eliminations;
+    t -> visits += s -> visits;
+    if(o -> bench)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        t -> latency[latency_bucket((stop.tv_sec - start.tv_sec) * 1000000000L + stop.tv_nsec - start.tv_nsec)]++;
+    }
+    return rc;
+}
+
+/*----------------------------------------------------------------------------*/
+/* state                                                                      */
+/*----------------------------------------------------------------------------*/
+int state(Sudoku *s)
+{
+    int rc;
+
+    /* 1 solved, 0 open, -1 contradicted, clear_premise() flags the contradictions */
+    if(s -> contradiction)
+        return -1;
+    rc = 1;
+    for(int xb = 0; xb < Box; xb++)
+    {
+        for(int yb = 0; yb < Box; yb++)
+        {
+            for(int xc = 0; xc < Box; xc++)
+            {
+                for(int yc = 0; yc < Box; yc++)
+                {
+                    if(CellPremises(s, xb, yb, xc, yc) > 1)
+                        rc = 0;
+                }
+            }
+        }
+    }
+    return rc;
+}
+
+/*----------------------------------------------------------------------------*/
+/* step_begin                                                                 */
+/*----------------------------------------------------------------------------*/
+int step_begin(Steps *st, char *puzzle)
+{
+    /* the text grows as needed and is reused for the next puzzles */
+    if(st -> text == NULL)
+    {
+        st -> size = 4096;
+        st -> text = malloc(st -> size);
+        if(st -> text == NULL)
+            return 0;
+    }
+    st -> length = 0;
+    st -> rounds = 0;
+    st -> state = StepNone;
+    return step_printf(st, "{\"puzzle\":\"%.*s\",\"rounds\":[", Cells, puzzle);
+}
+
+/*----------------------------------------------------------------------------*/
+/* step_cells                                                                 */
+/*----------------------------------------------------------------------------*/
+int step_cells(Sudoku *s, int unit, int places)
+{
+    /* another unit of the pattern found, as the other base lines of a fish */
+    if(s -> steps -> state != StepCells)
+        return 0;
+    for(int u = 1; u < FishSize; u++)
+    {
+        if(s -> steps -> places[u] == 0)
+        {
+            s -> steps -> units[u] = unit;
+            s -> steps -> places[u] = places;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* step_clear                                                                 */
+/*----------------------------------------------------------------------------*/
+int step_clear(Sudoku *s, int xb, int yb, int xc, int yc, int p)
+{
+    Steps *st;
+
+    /* only eliminations of deduce() rounds are logged */
+    st = s -> steps;
+    if(st -> state == StepNone)
+        return 0;
+
+    /* techniques without a found pattern get an empty one */
+    if(st -> state == StepRound)
+        step_found(s, 0, 0, 0);
+    if(st -> state == StepCells)
+        step_pattern(s);
+    return step_token(st, xb, yb, xc, yc, p);
+}
+
+/*----------------------------------------------------------------------------*/
+/* step_done                                                                  */
+/*----------------------------------------------------------------------------*/
+int step_done(Sudoku *s, int progress)
+{
+    Steps *st;
+
+    st = s -> steps;
+    if(st -> state == StepNone)
+        return 0;
+
+    /* close the last pattern with eliminations */
+    if(st -> state == StepEliminations)
+        step_printf(st, "]}");
+
+    /* keep the round only when the technique cleared premises */
+    if(st -> steps)
+    {
+        step_printf(st, "]}");
+        st -> rounds++;
+    }
+    st -> state = StepNone;
+    return progress;
+}
+
+/*----------------------------------------------------------------------------*/
+/* step_end                                                                   */
+/*----------------------------------------------------------------------------*/
+int step_end(Steps *st, FILE *f, char *line, int solved)
+{
+    if(st -> text == NULL)
+        return 0;
+
+    /* one write per puzzle keeps the lines of worker threads whole */
+    step_printf(st, "],\"solution\":\"%.*s\",\"solved\":%d}\n", Cells, line, solved);
+    fwrite(st -> text, 1, st -> length, f);
+    return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/* step_found                                                                 */
+/*----------------------------------------------------------------------------*/
+int step_found(Sudoku *s, int mask, int unit, int places)
+{
+    Steps *st;
+
+    st = s -> steps;
+    if(st -> state == StepNone)
+        return 0;
+
+    /* close the previous pattern, keep this one until it clears something */
+    if(st -> state == StepEliminations)
+        step_printf(st, "]}");
+    st -> mask = mask;
+    st -> units[0] = unit;
+    for(int u = 0; u < FishSize; u++)
+        st -> places[u] = 0;
+    st -> places[0] = places;
+    st -> state = StepCells;
+    return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/* step_pattern                                                               */
+/*----------------------------------------------------------------------------*/
+int step_pattern(Sudoku *s)
+{
+    char digits[Digits * 3];
+    int n;
+    const Cell *cell;
+    Steps *st;
+
+    /* the round is written with its first pattern */
+    st = s -> steps;
+    if(st -> steps == 0)
+        step_printf(st, "%s{\"technique\":\"%s\",\"steps\":[", st -> rounds ? "," : "", technique_names[st -> technique]);
+
+    /* write the pattern found with its digits and cells */
+    n = 0;
+    for(int p = 0; p < Digits; p++)
+    {
+        if(st -> mask & s -> premise_bit[p])
+        {
+            if(n)
+                digits[n++] = ',';
+            if(p >= 9)
+                digits[n++] = '0' + (p + 1) / 10;
+            digits[n++] = '0' + (p + 1) % 10;
+        }
+    }
+    digits[n] = 0;
+    step_printf(st, "%s{\"digits\":[%s],\"cells\":[", st -> steps++ ? "," : "", digits);
+    st -> items = 0;
+    for(int u = 0; u < FishSize; u++)
+    {
+        for(int i = 0; i < Digits; i++)
+        {
+            if(!(st -> places[u] & (1 << i)))
+                continue;
+            cell = &houses[st -> units[u]][i];
+            step_token(st, cell -> xb, cell -> yb, cell -> xc, cell -> yc, -1);
+        }
+    }
+
+    /* the eliminations follow */
+    step_printf(st, "],\"eliminations\":[");
+    st -> items = 0;
+    st -> state = StepEliminations;
+    return 1;
 }
 
 /*----------------------------------------------------------------------------*/
-/* deduce_yline_groups                                                        */
+/* step_printf                                                                */
 /*----------------------------------------------------------------------------*/
-int deduce_yline_group_cell(Sudoku *s, int xb, int yb, int xc, int yc)
+int step_printf(Steps *st, const char *format, ...)
 {
-    int c;
-    int mask;
-    int rc;
+    int n;
+    char *text;
+    va_list args;
 
-    /* skip solved cells */
-    if(s -> cell_premises[xb][yb][xc][yc] == 1)
-        return 0;
-
-    /* find group premises within y line */
-    c = 0;
-    mask = s -> cell_premise[xb][yb][xc][yc];
-    for(int y = yb * 3 + yc; y < 9; y++)
+    /* append to the text, doubling it when it is full */
+    for(;;)
     {
-        if(mask == s -> cell_premise[xb][y / 3][xc][y % 3])
-            c++;
+        va_start(args, format);
+        n = vsnprintf(st -> text + st -> length, st -> size - st -> length, format, args);
+        va_end(args);
+        if(n < 0)
+            return 0;
+        if(st -> length + n < st -> size)
+            break;
+        text = realloc(st -> text, st -> size * 2 + n);
+        if(text == NULL)
+            return 0;
+        st -> text = text;
+        st -> size = st -> size * 2 + n;
     }
+    st -> length += n;
+    return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/* step_round                                                                 */
+/*----------------------------------------------------------------------------*/
+int step_round(Sudoku *s, int t)
+{
+    Steps *st;
 
-    /* check if this is a group */
-    if(s -> cell_premises[xb][yb][xc][yc] != c)
+    st = s -> steps;
+    if(st -> text == NULL)
         return 0;
+    st -> technique = t;
+    st -> steps = 0;
+    st -> state = StepRound;
+    return 1;
+}
 
-    #ifdef __TRACE__
+/*----------------------------------------------------------------------------*/
+/* step_token                                                                 */
+/*----------------------------------------------------------------------------*/
+int step_token(Steps *st, int xb, int yb, int xc, int yc, int p)
+{
+    char *text;
+
+    /* cells and eliminations are the bulk of the log, write them without printf */
+    if(st -> size - st -> length < 16)
     {
-        int first;
-    
-        first = 1;
-        printf("  found c%dy%dy ", xb, xc);
-        for(int p = 0; p < 9; p++)
-        {
-            if(mask & s -> premise_bit[p])
-            {
-                if(first)
-                {
-                    printf("p%d", p + 1);
-                    first = 0;
-                }
-                else printf("-p%d", p + 1);
-            }
-        }
-        printf("\n");
+        text = realloc(st -> text, st -> size * 2);
+        if(text == NULL)
+            return 0;
+        st -> text = text;
+        st -> size *= 2;
     }
-    #endif
-
-    /* clear the group premises in other cells */
-    rc = 0;
-    for(int y = 0; y < 9; y++)
+    text = st -> text + st -> length;
+    if(st -> items++)
+        *text++ = ',';
+    *text++ = '"';
+    *text++ = 'c';
+    *text++ = '0' + xb;
+    *text++ = '0' + yb;
+    *text++ = '0' + xc;
+    *text++ = '0' + yc;
+    if(p >= 0)
     {
-         /* skip solved ones */
-         if(s -> cell_premises[xb][y / 3][xc][y / 3] == 1)
-             continue;
+        *text++ = 'p';
+        if(p >= 9)
+            *text++ = '0' + (p + 1) / 10;
+        *text++ = '0' + (p + 1) % 10;
+    }
+    *text++ = '"';
+    st -> length = text - st -> text;
+    return 1;
+}
 
-          /* skip cells part of the group */
-          if(s -> cell_premise[xb][y / 3][xc][y % 3] == mask)
-              continue;
+/*----------------------------------------------------------------------------*/
+/* sudoku_candidates                                                          */
+/*----------------------------------------------------------------------------*/
+int sudoku_candidates(const SudokuSolver *solver, SudokuMask *candidates)
+{
+    const Cell *cell;
 
-        /* clear premises */
-        for(int p = 0; p < 9; p++)
+    /* SudokuCells premise masks row by row, bit 0 for the first number */
+    for(int y = 0; y < Digits; y++)
+    {
+        for(int x = 0; x < Digits; x++)
         {
-            if(mask & s -> premise_bit[p])
-            {
-                if(clear_premise(s, xb, y / 3, xc, y % 3, p, "deduce_yline_group_cell()"))
-                    rc = 1;
-            }
+            cell = &houses[UnitXLine(y)][x];
+            candidates[y * Digits + x] = solver -> sudoku.cell_premise[cell -> xb][cell -> yb][cell -> xc][cell -> yc];
         }
     }
+    return 1;
+}
 
-    return rc;
+/*----------------------------------------------------------------------------*/
+/* sudoku_create                                                              */
+/*----------------------------------------------------------------------------*/
+SudokuSolver *sudoku_create(void)
+{
+    SudokuSolver *solver;
+
+    /* the only allocation, a solver is reused for any number of puzzles */
+    pthread_once(&twins_once, twins_default);
+    solver = malloc(sizeof(SudokuSolver));
+    if(solver == NULL)
+        return NULL;
+    solver -> pipeline = pipeline_full;
+    solver -> solutions = 0;
+    init(&solver -> sudoku);
+    solver -> sudoku.pipeline = &solver -> pipeline;
+    return solver;
 }
 
 /*----------------------------------------------------------------------------*/
-/* fill                                                                       */
+/* sudoku_destroy                                                             */
 /*----------------------------------------------------------------------------*/
-int fill(Sudoku *s)
+void sudoku_destroy(SudokuSolver *solver)
+{
+    free(solver);
+}
+
+/*----------------------------------------------------------------------------*/
+/* sudoku_grid                                                                */
+/*----------------------------------------------------------------------------*/
+int sudoku_grid(const SudokuSolver *solver, char *grid)
 {
     int rc;
-    int sudoku[9][9] = S;
 
-    Trace("fill()\n");
-    rc = 0;
-    for(int x = 0; x < 9; x++)
-    {
-        for(int y = 0; y < 9; y++)
-        {
-            if(sudoku[y][x])
-            {
-                Trace("  found c%d%d%d%d p%d\n", x / 3, y / 3, x % 3, y % 3, sudoku[y][x]);
-                for(int p = 0; p < 9; p++)
-                {
-                    /* clear all other premises within cell */
-                    if(p != sudoku[y][x] - 1)
-                    {
-                        if(clear_premise(s, x / 3, y / 3, x % 3, y % 3, p, "fill()"))
-                            rc = 1;
-                    }
-                }
-            }
-        }
-    }
-    return rc;
+    /* SudokuCells cells and a terminating zero, '.' for unsolved cells, 1 when solved */
+    rc = solution(&solver -> sudoku, grid);
+    grid[Cells] = '\0';
+    return rc && !solver -> sudoku.contradiction;
 }
 
 /*----------------------------------------------------------------------------*/
-/* init                                                                       */
+/* sudoku_load                                                                */
 /*----------------------------------------------------------------------------*/
-int init(Sudoku *s)
+int sudoku_load(SudokuSolver *solver, const char *grid)
 {
-    Trace("init()\n");
+    /* SudokuCells cells '1'..'9', 'A'.. given and '0' or '.' empty, 0 when not a puzzle */
+    if(!parse(grid))
+        return 0;
+    init(&solver -> sudoku);
+    solver -> sudoku.pipeline = &solver -> pipeline;
+    solver -> solutions = 0;
+    fill(&solver -> sudoku, grid);
+    return 1;
+}
 
-    /* init cleared */
-    s -> cleared = 0;
+/*----------------------------------------------------------------------------*/
+/* sudoku_pipeline                                                            */
+/*----------------------------------------------------------------------------*/
+int sudoku_pipeline(SudokuSolver *solver, const char *spec)
+{
+    Pipeline pl;
 
-    /* init static premise premise_bits */
-    for(int p = 0; p < 9; p++)
-        s -> premise_bit[p] = 1 << p;
-    
-    /* init block_premises */
-    for(int xb = 0; xb < 3; xb++)
+    /* the -x spec, the pipeline stays as it was when invalid */
+    if(!pipeline(&pl, spec))
+        return 0;
+    solver -> pipeline = pl;
+    return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/* sudoku_solve                                                               */
+/*----------------------------------------------------------------------------*/
+int sudoku_solve(SudokuSolver *solver, int limit)
+{
+    Sudoku *s;
+
+    /* deduce only, or search up to limit solutions and leave the first */
+    s = &solver -> sudoku;
+    if(limit > 0)
     {
-        for(int yb = 0; yb < 3; yb++)
-        {
-            for(int p = 0; p < 9; p++)
-                s -> block_premises[xb][yb][p] = 9;
-        }
+        solver -> solutions = search(s, &solver -> arena, limit);
+        return solver -> solutions ? SudokuSolved : SudokuContradicted;
     }
+    while(deduce(s));
+    return state(s);
+}
 
-    /* init cell_premise and cell_premises */
-    for(int xb = 0; xb < 3; xb++)
+/*----------------------------------------------------------------------------*/
+/* sudoku_stats                                                               */
+/*----------------------------------------------------------------------------*/
+int sudoku_stats(const SudokuSolver *solver, SudokuStats *stats)
+{
+    const Sudoku *s;
+
+    /* the counters of the puzzle loaded last */
+    s = &solver -> sudoku;
+    stats -> cleared = s -> cleared;
+    stats -> visits = s -> visits;
+    stats -> rounds = s -> rounds;
+    stats -> hardest = s -> hardest < 0 ? NULL : technique_names[s -> hardest];
+    stats -> score = s -> score;
+    stats -> contradiction = s -> contradiction;
+    stats -> solutions = solver -> solutions;
+    return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/* technique                                                                  */
+/*----------------------------------------------------------------------------*/
+int technique(const char *name, int n)
+{
+    /* the technique of the n characters of name, with or without deduce_, Techniques for unsolved, -1 unknown */
+    for(int t = 0; t < Techniques; t++)
     {
-        for(int yb = 0; yb < 3; yb++)
-        {
-            for(int xc = 0; xc < 3; xc++)
-            {
-                for(int yc = 0; yc < 3; yc++)
-                {
-                    s -> cell_premise[xb][yb][xc][yc] = AllPremiseBitsOn;
-                    s -> cell_premises[xb][yb][xc][yc] = 9;
-                }
-            }
-        }
+        if((n == (int)strlen(technique_names[t]) && strncmp(name, technique_names[t], n) == 0) ||
+           (n == (int)strlen(technique_names[t]) - 7 && strncmp(name, technique_names[t] + 7, n) == 0))
+            return t;
     }
+    return n == 8 && strncmp(name, "unsolved", 8) == 0 ? Techniques : -1;
+}
 
-    /* init line_premises */
-    for(int xy = 0; xy < 9; xy++)
+/*----------------------------------------------------------------------------*/
+/* subsets_avx2                                                               */
+/*----------------------------------------------------------------------------*/
+#if (defined(__x86_64__) || defined(__i386__)) && Box == 3
+__attribute__((target("avx2")))
+int subsets_avx2(const Mask *masks, int size, Mask *unions)
+{
+    int bits;
+    int n;
+    __m256i count;
+    __m256i found;
+    __m256i limit;
+    __m256i sizes;
+    __m256i u;
+    __m256i m[Digits];
+
+    /* 16 unions per row, count the masks within each, a group when as many as its bits up to size */
+    for(int i = 0; i < Digits; i++)
+        m[i] = _mm256_set1_epi16(masks[i]);
+    limit = _mm256_set1_epi16(size + 1);
+    n = 0;
+    for(int r = 0; r < SubsetUnions; r += 16)
     {
-        for(int p = 0; p < 9; p++)
-        {
-            s -> line_premises[X][xy][p] = 9;
-            s -> line_premises[Y][xy][p] = 9;
-        }
+        u = _mm256_loadu_si256((const __m256i *)&subset_unions[r]);
+        sizes = _mm256_loadu_si256((const __m256i *)&subset_sizes[r]);
+        count = _mm256_setzero_si256();
+        for(int i = 0; i < Digits; i++)
+            count = _mm256_sub_epi16(count, _mm256_cmpeq_epi16(_mm256_andnot_si256(u, m[i]), _mm256_setzero_si256()));
+        found = _mm256_and_si256(_mm256_cmpeq_epi16(count, sizes), _mm256_cmpgt_epi16(limit, sizes));
+
+        /* two bits per 16 bit lane */
+        for(bits = _mm256_movemask_epi8(found); bits; bits &= bits - 1, bits &= bits - 1)
+            unions[n++] = subset_unions[r + __builtin_ctz(bits) / 2];
     }
+    return n;
+}
+#endif
 
-    return 0;
+/*----------------------------------------------------------------------------*/
+/* subsets_scalar                                                             */
+/*----------------------------------------------------------------------------*/
+int subsets_scalar(const Mask *masks, int size, Mask *unions)
+{
+    /* the unions of the masks added one by one, any box size */
+    return subsets_search(masks, size, 0, 0, 0, unions, 0);
 }
 
 /*----------------------------------------------------------------------------*/
-/* main                                                                       */
+/* subsets_search                                                             */
 /*----------------------------------------------------------------------------*/
-int main(void)
+int subsets_search(const Mask *masks, int size, int first, int count, int mask, Mask *unions, int n)
 {
-    Sudoku s;
-    
-    /* Initialize, print and fill */
-    init(&s);
-    print(&s);
-    fill(&s);
+    int bits;
+    int next;
 
-    /* print and deduce until deduced */
-    do
+    /* add the masks from first on to the union of count masks, pruned once it holds more than size bits */
+    for(int i = first; i < Digits && n < SubsetUnions; i++)
     {
-        print(&s);
+        next = mask | masks[i];
+        bits = __builtin_popcount(next);
+        if(bits > size)
+            continue;
+
+        /* 3 up to size masks with as many bits in their union, the smaller ones the twins find */
+        if(count >= 2 && bits == count + 1)
+            unions[n++] = next;
+        else if(count + 1 < size)
+            n = subsets_search(masks, size, i + 1, count + 1, next, unions, n);
     }
-    while (deduce(&s));
+    return n;
 }
 
 /*----------------------------------------------------------------------------*/
-/* number                                                                     */
+/* subsets_sse2                                                               */
 /*----------------------------------------------------------------------------*/
-int number(int p)
+#if (defined(__x86_64__) || defined(__i386__)) && Box == 3
+__attribute__((target("sse2")))
+int subsets_sse2(const Mask *masks, int size, Mask *unions)
 {
-    /* return the bit position number */
-    if(p & 0x001)
-        return 0;
-    if(p & 0x002)
-        return 1;
-    if(p & 0x004)
-        return 2;
-    if(p & 0x008)
-        return 3;
-    if(p & 0x010)
-        return 4;
-    if(p & 0x020)
-        return 5;
-    if(p & 0x040)
-        return 6;
-    if(p & 0x080)
-        return 7;
-    if(p & 0x100)
-        return 8;
-    return -1;
+    int bits;
+    int n;
+    __m128i count;
+    __m128i found;
+    __m128i limit;
+    __m128i sizes;
+    __m128i u;
+    __m128i m[Digits];
+
+    /* 8 unions per row, count the masks within each, a group when as many as its bits up to size */
+    for(int i = 0; i < Digits; i++)
+        m[i] = _mm_set1_epi16(masks[i]);
+    limit = _mm_set1_epi16(size + 1);
+    n = 0;
+    for(int r = 0; r < SubsetUnions; r += 8)
+    {
+        u = _mm_loadu_si128((const __m128i *)&subset_unions[r]);
+        sizes = _mm_loadu_si128((const __m128i *)&subset_sizes[r]);
+        count = _mm_setzero_si128();
+        for(int i = 0; i < Digits; i++)
+            count = _mm_sub_epi16(count, _mm_cmpeq_epi16(_mm_andnot_si128(u, m[i]), _mm_setzero_si128()));
+        found = _mm_and_si128(_mm_cmpeq_epi16(count, sizes), _mm_cmpgt_epi16(limit, sizes));
+
+        /* two bits per 16 bit lane */
+        for(bits = _mm_movemask_epi8(found); bits; bits &= bits - 1, bits &= bits - 1)
+            unions[n++] = subset_unions[r + __builtin_ctz(bits) / 2];
+    }
+    return n;
 }
+#endif
 
 /*----------------------------------------------------------------------------*/
-/* print                                                                      */
+/* twins_avx2                                                                 */
 /*----------------------------------------------------------------------------*/
-int print(Sudoku *s)
+#if (defined(__x86_64__) || defined(__i386__)) && Box == 3
+__attribute__((target("avx2")))
+int twins_avx2(const Mask *masks, Mask *equal)
 {
-    int p;
+    int bits;
+    __m256i all;
+    __m256i eq;
 
-    Trace("print()\n");
-    printf("\n");
+    /* all 9 masks in one register, the 7 spare lanes never equal a 9 bit mask */
+    all = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)masks)), _mm_insert_epi16(_mm_set1_epi16(-1), masks[8], 0), 1);
+    for(int i = 0; i < Digits; i++)
+    {
+        /* pack the 16 bit compares to bytes, lane 0 gives bits 0..7, lane 1 bits 16.. */
+        eq = _mm256_cmpeq_epi16(all, _mm256_set1_epi16(masks[i]));
+        bits = _mm256_movemask_epi8(_mm256_packs_epi16(eq, eq));
+        equal[i] = (bits & 0xff) | (bits >> 8 & 0x100);
+    }
+    return 0;
+}
+#endif
 
-    /* print sudoku */
-    #ifdef __TRACE__
-        /* print line statistics */
-        for(int p = 0; p < 9; p++)
-        {
-            printf("          ");
-            for(int x = 0; x < 9; x++)
-            {
-                if(x && x % 3 == 0)
-                    printf("  ");
-                printf(" %d", s -> line_premises[Y][x][p]);
-            }
-            printf("\n");
-        }
-        printf("         ");
-    #endif
-    printf(" -----------------------\n");
-    for(int y = 0; y < 9; y++)
+/*----------------------------------------------------------------------------*/
+/* twins_scalar                                                               */
+/*----------------------------------------------------------------------------*/
+int twins_scalar(const Mask *masks, Mask *equal)
+{
+    /* per mask the masks equal to it, bit j for mask j */
+    for(int i = 0; i < Digits; i++)
     {
-        if(y && y % 3 == 0)
-        {
-            #ifdef __TRACE__
-                printf("         ");
-            #endif
-            printf("|                       |\n");
-        }
-        #ifdef __TRACE__
-            for(int p = 0; p < 9; p++)
-            {
-                printf("%d", s -> line_premises[X][y][p]);
-            }
-        #endif
-        for(int x = 0; x < 9; x++)
+        equal[i] = 0;
+        for(int j = 0; j < Digits; j++)
         {
-            if(x && x % 3 == 0)
-                printf("  ");
-            if(x == 0)
-                printf("|");
-            if(s -> cell_premises[x / 3][y / 3][x % 3][y % 3] == 1)
-                printf(" %d", number(s -> cell_premise[x / 3][y / 3][x % 3][y % 3]) + 1);
-            else
-                printf(" .");
-            if(x == 8)
-                printf(" |");
+            if(masks[j] == masks[i])
+                equal[i] |= 1 << j;
         }
-        printf("\n");
     }
-    #ifdef __TRACE__
-        printf("         ");
-    #endif
-    printf(" -----------------------\n");
-
-    /* print cell statistics */
-    #ifdef __TRACE__
-        all_cells(s, print_cell);
-        printf("\n");
-    #endif
     return 0;
 }
 
 /*----------------------------------------------------------------------------*/
-/* print_cell                                                                 */
+/* twins_default                                                              */
 /*----------------------------------------------------------------------------*/
-int print_cell(Sudoku *s, int xb, int yb, int xc, int yc)
+void twins_default(void)
 {
-    /* print block premises */
-    if(xc == 0 && yc == 0)
+    /* the widest kernel the cpu supports */
+    twins_select(NULL);
+}
+
+/*----------------------------------------------------------------------------*/
+/* twins_select                                                               */
+/*----------------------------------------------------------------------------*/
+int twins_select(char *kernel)
+{
+    /* the widest kernel the cpu supports, or the one asked for */
+#if (defined(__x86_64__) || defined(__i386__)) && Box == 3
+    __builtin_cpu_init();
+    if((kernel == NULL || strcmp(kernel, "avx2") == 0) && __builtin_cpu_supports("avx2"))
     {
-        printf("\n      ");
-        for(int p = 0; p < 9; p++)
-        {
-            if(s -> block_premises[xb][yb][p])
-                printf("%d", s -> block_premises[xb][yb][p]);
-            else
-                printf(".");
-        }
-        printf("\n");
-    }    
+        twins = twins_avx2;
+        subsets = subsets_avx2;
+        return 1;
+    }
+    if((kernel == NULL || strcmp(kernel, "sse2") == 0) && __builtin_cpu_supports("sse2"))
+    {
+        twins = twins_sse2;
+        subsets = subsets_sse2;
+        return 1;
+    }
+#endif
+    twins = twins_scalar;
+    subsets = subsets_scalar;
+    return kernel == NULL || strcmp(kernel, "scalar") == 0;
+}
 
-    /* print cell premises */
-    printf("%d%d%d%d: ", xb, yb, xc, yc);
-    for(int p = 0; p < 9; p++)
+/*----------------------------------------------------------------------------*/
+/* twins_sse2                                                                 */
+/*----------------------------------------------------------------------------*/
+#if (defined(__x86_64__) || defined(__i386__)) && Box == 3
+__attribute__((target("sse2")))
+int twins_sse2(const Mask *masks, Mask *equal)
+{
+    __m128i eq;
+    __m128i low;
+
+    /* masks 0..7 in one register, mask 8 on the side */
+    low = _mm_loadu_si128((const __m128i *)masks);
+    for(int i = 0; i < Digits; i++)
     {
-        if(s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
-            printf("%d", p + 1);
-        else
-            printf(".");
+        eq = _mm_cmpeq_epi16(low, _mm_set1_epi16(masks[i]));
+        equal[i] = (_mm_movemask_epi8(_mm_packs_epi16(eq, eq)) & 0xff) | (masks[8] == masks[i]) << 8;
     }
+    return 0;
+}
+#endif
 
-    /* print cell premise size or sudoku value */
-    printf(" %d\n", s -> cell_premises[xb][yb][xc][yc]);
+/*----------------------------------------------------------------------------*/
+/* undo                                                                       */
+/*----------------------------------------------------------------------------*/
+int undo(Sudoku *s, int mark)
+{
+    int n;
+    int p;
+    int xb;
+    int yb;
+    int xc;
+    int yc;
+
+    /* put back the premises cleared after the mark, last first */
+    while(s -> trail -> tail > mark)
+    {
+        n = s -> trail -> clears[--s -> trail -> tail];
+        s -> visits++;
+        p = n % Digits;
+        n /= Digits;
+        xb = n / (Box * Digits);
+        yb = n / Digits % Box;
+        xc = n / Box % Box;
+        yc = n % Box;
+
+        s -> cell_premise[xb][yb][xc][yc] |= s -> premise_bit[p];
+
+        #ifndef __POPCOUNT__
+            s -> cell_premises[xb][yb][xc][yc]++;
+            s -> block_premises[xb][yb][p]++;
+            s -> line_premises[X][yb * Box + yc][p]++;
+            s -> line_premises[Y][xb * Box + xc][p]++;
+        #endif
 
+        s -> block_places[xb][yb][p] |= 1 << (xc * Box + yc);
+        s -> line_places[X][yb * Box + yc][p] |= 1 << (xb * Box + xc);
+        s -> line_places[Y][xb * Box + xc][p] |= 1 << (yb * Box + yc);
+    }
     return 0;
 }
 
@@ -1451,26 +4346,35 @@ int verify(Sudoku *s)
 /*----------------------------------------------------------------------------*/
 int verify_block(Sudoku *s, int xb, int yb)
 {
-    int block_premises[9];
+    Mask block_places[Digits];
+    int block_premises[Digits];
 
-    for(int i = 0; i < 9; i++)
+    for(int i = 0; i < Digits; i++)
+    {
+        block_places[i] = 0;
         block_premises[i] = 0;
-    for(int xc = 0; xc < 3; xc++)
+    }
+    for(int xc = 0; xc < Box; xc++)
     {
-        for(int yc = 0; yc < 3; yc++)
+        for(int yc = 0; yc < Box; yc++)
         {
-            for(int p = 0; p < 9; p++)
+            for(int p = 0; p < Digits; p++)
             {
                 if(s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
+                {
+                    block_places[p] |= 1 << (xc * Box + yc);
                     block_premises[p]++;
+                }
             }
         }
     }
-    for(int p = 0; p < 9; p++)
+    for(int p = 0; p < Digits; p++)
     {
-        if(block_premises[p] != s -> block_premises[xb][yb][p])
+        if(block_places[p] != s -> block_places[xb][yb][p])
+            return 1;
+        if(block_premises[p] != BlockPremises(s, xb, yb, p))
             return 1;
-        if(block_premises[p] < 1 || block_premises[p] > 9)
+        if((block_premises[p] < 1 && !s -> contradiction) || block_premises[p] > Digits)
             return 1;
     }
     return 0;
@@ -1484,14 +4388,14 @@ int verify_cell(Sudoku *s, int xb, int yb, int xc, int yc)
     int premises;
 
     premises = 0;
-    for(int p = 0; p < 9; p++)
+    for(int p = 0; p < Digits; p++)
     {
         if(s -> cell_premise[xb][yb][xc][yc] & s -> premise_bit[p])
             premises++;
     }
-    if(premises != s -> cell_premises[xb][yb][xc][yc])
+    if(premises != CellPremises(s, xb, yb, xc, yc))
         return 1;
-    if(premises < 1 || premises > 9)
+    if((premises < 1 && !s -> contradiction) || premises > Digits)
         return 1;
     return 0;
 }
@@ -1501,31 +4405,42 @@ int verify_cell(Sudoku *s, int xb, int yb, int xc, int yc)
 /*----------------------------------------------------------------------------*/
 int verify_xline(Sudoku *s)
 {
-    int line_premises[2][9][9];
+    Mask line_places[2][Digits][Digits];
+    int line_premises[2][Digits][Digits];
+    const Cell *cell;
 
-    for(int y = 0; y < 9; y++)
+    for(int y = 0; y < Digits; y++)
     {
-        for(int p = 0; p < 9; p++)
+        for(int p = 0; p < Digits; p++)
+        {
+            line_places[X][y][p] = 0;
             line_premises[X][y][p] = 0;
+        }
     }
-    for(int y = 0; y < 9; y++)
+    for(int y = 0; y < Digits; y++)
     {
-        for(int p = 0; p < 9; p++)
+        for(int p = 0; p < Digits; p++)
         {
-            for(int x = 0; x < 9; x++)
+            for(int x = 0; x < Digits; x++)
             {
-                if(s -> cell_premise[x / 3][y / 3][x % 3][y % 3] & s -> premise_bit[p])
+                cell = &houses[UnitXLine(y)][x];
+                if(s -> cell_premise[cell -> xb][cell -> yb][cell -> xc][cell -> yc] & s -> premise_bit[p])
+                {
+                    line_places[X][y][p] |= 1 << x;
                     line_premises[X][y][p]++;
+                }
             }
         }
     }
-    for(int y = 0; y < 9; y++)
+    for(int y = 0; y < Digits; y++)
     {
-        for(int p = 0; p < 9; p++)
+        for(int p = 0; p < Digits; p++)
         {
-            if(line_premises[X][y][p] != s -> line_premises[X][y][p])
+            if(line_places[X][y][p] != s -> line_places[X][y][p])
                 return 1;
-            if(line_premises[X][y][p] < 1 || line_premises[X][y][p] > 9)
+            if(line_premises[X][y][p] != LinePremises(s, X, y, p))
+                return 1;
+            if((line_premises[X][y][p] < 1 && !s -> contradiction) || line_premises[X][y][p] > Digits)
                 return 1;
         }
     }
@@ -1537,31 +4452,42 @@ int verify_xline(Sudoku *s)
 /*----------------------------------------------------------------------------*/
 int verify_yline(Sudoku *s)
 {
-    int line_premises[2][9][9];
+    Mask line_places[2][Digits][Digits];
+    int line_premises[2][Digits][Digits];
+    const Cell *cell;
 
-    for(int x = 0; x < 9; x++)
+    for(int x = 0; x < Digits; x++)
     {
-        for(int p = 0; p < 9; p++)
+        for(int p = 0; p < Digits; p++)
+        {
+            line_places[Y][x][p] = 0;
             line_premises[Y][x][p] = 0;
+        }
     }
-    for(int x = 0; x < 9; x++)
+    for(int x = 0; x < Digits; x++)
     {
-        for(int p = 0; p < 9; p++)
+        for(int p = 0; p < Digits; p++)
         {
-            for(int y = 0; y < 9; y++)
+            for(int y = 0; y < Digits; y++)
             {
-                if(s -> cell_premise[x / 3][y / 3][x % 3][y % 3] & s -> premise_bit[p])
+                cell = &houses[UnitYLine(x)][y];
+                if(s -> cell_premise[cell -> xb][cell -> yb][cell -> xc][cell -> yc] & s -> premise_bit[p])
+                {
+                    line_places[Y][x][p] |= 1 << y;
                     line_premises[Y][x][p]++;
+                }
             }
         }
     }
-    for(int x = 0; x < 9; x++)
+    for(int x = 0; x < Digits; x++)
     {
-        for(int p = 0; p < 9; p++)
+        for(int p = 0; p < Digits; p++)
         {
-            if(line_premises[Y][x][p] != s -> line_premises[Y][x][p])
+            if(line_places[Y][x][p] != s -> line_places[Y][x][p])
+                return 1;
+            if(line_premises[Y][x][p] != LinePremises(s, Y, x, p))
                 return 1;
-            if(line_premises[Y][x][p] < 1 || line_premises[Y][x][p] > 9)
+            if((line_premises[Y][x][p] < 1 && !s -> contradiction) || line_premises[Y][x][p] > Digits)
                 return 1;
         }
     }
@@ -0,0 +1,73 @@
+/*----------------------------------------------------------------------------*/
+/* sudoku.h (c) 2021 Bernard van der Helm, The Hague, The Netherlands         */
+/*----------------------------------------------------------------------------*/
+#ifndef SUDOKU_H
+#define SUDOKU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* exported from the library, the rest of sudoku.c stays hidden */
+#define SudokuExport __attribute__((visibility("default")))
+
+/* box size, 3 for 9x9 boards, 2, 4 or 5 for 4x4, 16x16 or 25x25, at compile time */
+#ifndef SudokuBox
+#define SudokuBox 3
+#endif
+#define SudokuDigits (SudokuBox * SudokuBox)
+#define SudokuCells (SudokuDigits * SudokuDigits)
+
+/* premises of a cell, bit 0 for the first digit, 32 bits from 25x25 on */
+#if SudokuBox <= 4
+typedef unsigned short SudokuMask;
+#else
+typedef unsigned int SudokuMask;
+#endif
+
+/* state of a solver after sudoku_solve() */
+#define SudokuContradicted -1
+#define SudokuOpen 0
+#define SudokuSolved 1
+
+/* a solver, created once and reused for any number of puzzles */
+typedef struct SudokuSolver SudokuSolver;
+
+/*----------------------------------------------------------------------------*/
+/* cleared       : number of premises cleared                                 */
+/* visits        : number of cells visited by the deductions and the search   */
+/*                 restores, on dead branches too                             */
+/* rounds        : number of deduce() calls that made progress                */
+/* hardest       : name of the hardest technique that made progress, or NULL  */
+/* score         : sum of the technique weights of the rounds                 */
+/* contradiction : cleared count at the contradiction, 0 when none            */
+/* solutions     : solutions found by the search, up to its limit             */
+/*----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    int cleared;
+    long visits;
+    int rounds;
+    const char *hardest;
+    int score;
+    int contradiction;
+    int solutions;
+}
+SudokuStats;
+
+/* library functions, no output and no allocation after sudoku_create() */
+SudokuExport SudokuSolver *sudoku_create(void);
+SudokuExport void sudoku_destroy(SudokuSolver *solver);
+SudokuExport int sudoku_candidates(const SudokuSolver *solver, SudokuMask *candidates);
+SudokuExport int sudoku_grid(const SudokuSolver *solver, char *grid);
+SudokuExport int sudoku_load(SudokuSolver *solver, const char *grid);
+SudokuExport int sudoku_pipeline(SudokuSolver *solver, const char *spec);
+SudokuExport int sudoku_solve(SudokuSolver *solver, int limit);
+SudokuExport int sudoku_stats(const SudokuSolver *solver, SudokuStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif